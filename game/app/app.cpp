@@ -589,7 +589,8 @@ void App::update() noexcept
 #endif
 
 
-  manager.generate_chunks(g_state.ecs.get_component<Transform>(g_state.player.self)->pos, g_state.player.render_distance);
+  manager.generate_chunks(g_state.ecs.get_component<Transform>(g_state.player.self)->pos, g_state.player.render_distance,
+      *g_state.ecs.get_component<FrustumVolume>(g_state.player.camera));
 
 }
 void App::render() noexcept
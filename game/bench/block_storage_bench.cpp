@@ -0,0 +1,96 @@
+// Random-access and full-scan speed of PaletteStorage against a flat uint8_t array,
+// plus the bytes each layout keeps resident per chunk.
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+
+import block_storage;
+
+namespace {
+
+constexpr std::uint32_t VOLUME = 16 * 16 * 16;
+constexpr int CHUNKS = 512;
+constexpr int RANDOM_READS = 1 << 22;
+constexpr int SCANS = 64;
+
+struct Case {
+  const char* name;
+  int types; // distinct block types in the chunk
+};
+
+template <typename Fn>
+double time_ns(Fn&& fn) {
+  auto start = std::chrono::steady_clock::now();
+  fn();
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+int main() {
+  const Case cases[] = {
+    { "uniform", 1 },
+    { "2 types", 2 },
+    { "4 types", 4 },
+    { "12 types", 12 },
+    { "40 types", 40 },
+  };
+
+  std::printf("%-10s %5s %12s %12s %14s %14s %14s %14s\n",
+      "chunk", "bits", "flat B", "palette B", "flat rnd ns", "pal rnd ns", "flat scan ns", "pal scan ns");
+
+  for (const Case& c : cases) {
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<int> type_dist(0, c.types - 1);
+
+    std::vector<std::unique_ptr<std::uint8_t[]>> flat(CHUNKS);
+    std::vector<std::unique_ptr<PaletteStorage<VOLUME>>> packed(CHUNKS);
+    for (int i = 0; i < CHUNKS; i++) {
+      flat[i].reset(new std::uint8_t[VOLUME]{});
+      packed[i] = std::make_unique<PaletteStorage<VOLUME>>();
+      for (std::uint32_t v = 0; v < VOLUME; v++) {
+        std::uint8_t t = static_cast<std::uint8_t>(type_dist(rng));
+        flat[i][v] = t;
+        packed[i]->set(v, t);
+      }
+      packed[i]->compact();
+    }
+
+    std::vector<std::uint32_t> lookups(RANDOM_READS);
+    for (auto& l : lookups)
+      l = rng() % (CHUNKS * VOLUME);
+
+    volatile std::uint32_t sink = 0;
+    std::uint32_t acc = 0;
+
+    double flat_rnd = time_ns([&] {
+      for (std::uint32_t l : lookups)
+        acc += flat[l / VOLUME][l % VOLUME];
+    }) / RANDOM_READS;
+    double pal_rnd = time_ns([&] {
+      for (std::uint32_t l : lookups)
+        acc += packed[l / VOLUME]->get(l % VOLUME);
+    }) / RANDOM_READS;
+
+    double flat_scan = time_ns([&] {
+      for (int s = 0; s < SCANS; s++)
+        for (int i = 0; i < CHUNKS; i++)
+          for (std::uint32_t v = 0; v < VOLUME; v++)
+            acc += flat[i][v];
+    }) / (double(SCANS) * CHUNKS * VOLUME);
+    double pal_scan = time_ns([&] {
+      for (int s = 0; s < SCANS; s++)
+        for (int i = 0; i < CHUNKS; i++)
+          packed[i]->for_each([&](std::uint32_t, std::uint8_t t) { acc += t; });
+    }) / (double(SCANS) * CHUNKS * VOLUME);
+    sink = acc;
+
+    const std::size_t palette_bytes = sizeof(PaletteStorage<VOLUME>) + packed[0]->heap_bytes();
+    std::printf("%-10s %5u %12u %12zu %14.3f %14.3f %14.4f %14.4f\n",
+        c.name, packed[0]->bits_per_voxel(), VOLUME, palette_bytes, flat_rnd, pal_rnd, flat_scan, pal_scan);
+  }
+  return 0;
+}
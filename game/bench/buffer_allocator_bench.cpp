@@ -0,0 +1,307 @@
+// BufferAllocator (TLSF) against the scan allocator ChunkRenderer used before it, replaying the
+// same alloc/free trace through both: time per operation, failed allocations and how
+// fragmented the free space gets.
+//
+//   xmake run bench_buffer_allocator [trace]
+//
+// Without a trace file, one is recorded from a synthetic streaming session: a player walking
+// through a world of chunks, each holding 6 face allocations, with remeshes of nearby chunks
+// on the way. A trace file has one operation per line, "a <id> <quads>" or "f <id>".
+//
+// The TLSF allocator is checked while replaying (no overlapping allocations, validate() on its
+// lists and counters); any failure is reported and the process exits with 1, so this doubles
+// as its test.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <optional>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+import buffer_allocator;
+
+namespace {
+
+struct Op {
+  bool alloc;
+  std::uint32_t id;
+  std::uint32_t quads;
+};
+
+constexpr int RENDER_DISTANCE = 12;
+constexpr int STEPS = 400;
+
+// Quads of one chunk face: mostly small, a long tail of big ones, some empty
+std::uint32_t face_quads(std::mt19937& rng) {
+  std::lognormal_distribution<float> size(4.5f, 1.1f);
+  return rng() % 8 == 0 ? 0 : std::min(static_cast<std::uint32_t>(size(rng)), 60000u);
+}
+
+std::vector<Op> record_streaming() {
+  std::mt19937 rng(7);
+  std::vector<Op> trace;
+  std::uint32_t nextId = 0;
+  // Live face allocations per loaded column (x, z)
+  std::map<std::pair<int, int>, std::vector<std::uint32_t>> loaded;
+
+  const auto load = [&](int x, int z) {
+    std::vector<std::uint32_t>& ids = loaded[{ x, z }];
+    for (int face = 0; face < 6; face++) {
+      if (const std::uint32_t quads = face_quads(rng)) {
+        trace.push_back({ true, nextId, quads });
+        ids.push_back(nextId++);
+      }
+    }
+  };
+
+  int px = 0, pz = 0;
+  for (int step = 0; step < STEPS; step++) {
+    // Mostly straight, now and then a turn
+    if (step % 40 < 30)
+      px++;
+    else
+      pz += step % 80 < 40 ? 1 : -1;
+
+    for (auto it = loaded.begin(); it != loaded.end();) {
+      const auto [x, z] = it->first;
+      if (std::abs(x - px) > RENDER_DISTANCE || std::abs(z - pz) > RENDER_DISTANCE) {
+        for (std::uint32_t id : it->second)
+          trace.push_back({ false, id, 0 });
+        it = loaded.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    for (int x = px - RENDER_DISTANCE; x <= px + RENDER_DISTANCE; x++)
+      for (int z = pz - RENDER_DISTANCE; z <= pz + RENDER_DISTANCE; z++)
+        if (!loaded.contains({ x, z }))
+          load(x, z);
+
+    // A few edits near the player: the chunk's faces are freed and allocated again
+    for (int edit = 0; edit < 4; edit++) {
+      const std::pair<int, int> column{ px + int(rng() % 5) - 2, pz + int(rng() % 5) - 2 };
+      for (std::uint32_t id : loaded[column])
+        trace.push_back({ false, id, 0 });
+      loaded.erase(column);
+      load(column.first, column.second);
+    }
+  }
+  return trace;
+}
+
+std::optional<std::vector<Op>> read_trace(const char* path) {
+  std::FILE* file = std::fopen(path, "r");
+  if (!file)
+    return std::nullopt;
+  std::vector<Op> trace;
+  char kind;
+  unsigned id, quads;
+  while (std::fscanf(file, " %c %u", &kind, &id) == 2) {
+    if (kind == 'a' && std::fscanf(file, " %u", &quads) == 1)
+      trace.push_back({ true, id, quads });
+    else if (kind == 'f')
+      trace.push_back({ false, id, 0 });
+  }
+  std::fclose(file);
+  return trace;
+}
+
+// What ChunkRenderer::getDrawCommand / removeDrawCommand did: bump allocation until the end of
+// the buffer, then a best-fit scan over the used slots sorted by offset, and a linear search
+// to free
+class ScanAllocator {
+public:
+  explicit ScanAllocator(std::uint32_t capacity) : capacity(capacity) {}
+
+  std::optional<std::uint32_t> allocate(std::uint32_t size) {
+    if (capacity - end >= size) {
+      slots.push_back({ end, size });
+      end += size;
+      return slots.back().offset;
+    }
+    std::uint32_t bestPos = 0, bestSpace = ~0u;
+    auto bestIt = slots.end();
+    bool found = false;
+    std::uint32_t pos = 0;
+    for (auto it = slots.begin(); it <= slots.end(); ++it) {
+      // The last gap runs to the end of the buffer
+      const std::uint32_t space = (it == slots.end() ? capacity : it->offset) - pos;
+      if (space >= size && space < bestSpace) {
+        bestPos = pos;
+        bestSpace = space;
+        bestIt = it;
+        found = true;
+      }
+      if (it == slots.end())
+        break;
+      pos = it->offset + it->size;
+    }
+    if (!found)
+      return std::nullopt;
+    slots.insert(bestIt, { bestPos, size });
+    return bestPos;
+  }
+
+  void free(std::uint32_t offset) {
+    for (auto it = slots.begin(); it != slots.end(); ++it) {
+      if (it->offset == offset) {
+        slots.erase(it);
+        return;
+      }
+    }
+  }
+
+  // Largest gap, the bump space included
+  float fragmentation() const {
+    std::uint32_t pos = 0, largest = 0, used = 0;
+    for (const Slot& slot : slots) {
+      largest = std::max(largest, slot.offset - pos);
+      pos = slot.offset + slot.size;
+      used += slot.size;
+    }
+    largest = std::max(largest, capacity - pos);
+    return used == capacity ? 0.0f : 1.0f - float(largest) / float(capacity - used);
+  }
+
+private:
+  struct Slot {
+    std::uint32_t offset;
+    std::uint32_t size;
+  };
+  std::uint32_t capacity;
+  std::uint32_t end = 0;
+  std::vector<Slot> slots;
+};
+
+struct Result {
+  std::vector<double> ns;
+  int failed = 0;
+  float maxFragmentation = 0.0f;
+};
+
+void print(const char* name, Result& result) {
+  std::sort(result.ns.begin(), result.ns.end());
+  double total = 0.0;
+  for (double t : result.ns)
+    total += t;
+  std::printf("%-6s %10.1f %10.0f %10.0f %10.2f %8d %9.0f%%\n", name, total / result.ns.size(),
+      result.ns[result.ns.size() / 2], result.ns[result.ns.size() * 99 / 100], total / 1e6, result.failed,
+      result.maxFragmentation * 100.0f);
+}
+
+// Nanoseconds of one call
+template <typename Fn>
+double time_ns(Fn&& fn) {
+  const auto start = std::chrono::steady_clock::now();
+  fn();
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  std::vector<Op> trace;
+  if (argc > 1) {
+    std::optional<std::vector<Op>> file = read_trace(argv[1]);
+    if (!file) {
+      std::printf("can't read %s\n", argv[1]);
+      return 1;
+    }
+    trace = std::move(*file);
+  } else {
+    trace = record_streaming();
+  }
+
+  // Room for the peak live quads plus a third, so the buffer has to be reused
+  std::uint64_t live = 0, peak = 0;
+  std::unordered_map<std::uint32_t, std::uint32_t> sizes;
+  for (const Op& op : trace) {
+    if (op.alloc) {
+      sizes[op.id] = op.quads;
+      live += op.quads;
+      peak = std::max(peak, live);
+    } else {
+      live -= sizes[op.id];
+    }
+  }
+  const std::uint32_t capacity = static_cast<std::uint32_t>(std::min<std::uint64_t>(peak + peak / 3, ~0u));
+  std::printf("%zu operations, peak %llu quads live, capacity %u quads\n", trace.size(),
+      static_cast<unsigned long long>(peak), capacity);
+
+  bool valid = true;
+  Result tlsf, scan;
+  {
+    BufferAllocator allocator(capacity);
+    std::unordered_map<std::uint32_t, BufferAllocation> allocations;
+    std::map<std::uint32_t, std::uint32_t> ranges; // offset -> quads, to check for overlaps
+    for (std::size_t i = 0; i < trace.size(); i++) {
+      const Op& op = trace[i];
+      if (op.alloc) {
+        std::optional<BufferAllocation> allocation;
+        tlsf.ns.push_back(time_ns([&] { allocation = allocator.allocate(op.quads); }));
+        if (!allocation) {
+          tlsf.failed++;
+          continue;
+        }
+        auto next = ranges.lower_bound(allocation->offset);
+        const bool overlaps = allocation->offset + op.quads > capacity ||
+          (next != ranges.end() && next->first < allocation->offset + op.quads) ||
+          (next != ranges.begin() && std::prev(next)->first + std::prev(next)->second > allocation->offset);
+        if (overlaps) {
+          std::printf("operation %zu: allocation of %u quads at %u overlaps\n", i, op.quads, allocation->offset);
+          valid = false;
+        }
+        ranges[allocation->offset] = op.quads;
+        allocations[op.id] = *allocation;
+      } else if (auto it = allocations.find(op.id); it != allocations.end()) {
+        tlsf.ns.push_back(time_ns([&] { allocator.free(it->second.handle); }));
+        ranges.erase(it->second.offset);
+        allocations.erase(it);
+      }
+      if (i % 1024 == 0) {
+        tlsf.maxFragmentation = std::max(tlsf.maxFragmentation, allocator.get_stats().fragmentation());
+        if (!allocator.validate()) {
+          std::printf("operation %zu: allocator lists or counters are inconsistent\n", i);
+          valid = false;
+        }
+      }
+    }
+    for (const auto& [id, allocation] : allocations)
+      allocator.free(allocation.handle);
+    const BufferAllocatorStats stats = allocator.get_stats();
+    if (!allocator.validate() || stats.used != 0 || stats.freeBlocks != 1 || stats.largestFree != capacity) {
+      std::printf("free space didn't merge back into one block\n");
+      valid = false;
+    }
+  }
+  {
+    ScanAllocator allocator(capacity);
+    std::unordered_map<std::uint32_t, std::uint32_t> offsets;
+    for (std::size_t i = 0; i < trace.size(); i++) {
+      const Op& op = trace[i];
+      if (op.alloc) {
+        std::optional<std::uint32_t> offset;
+        scan.ns.push_back(time_ns([&] { offset = allocator.allocate(op.quads); }));
+        if (offset)
+          offsets[op.id] = *offset;
+        else
+          scan.failed++;
+      } else if (auto it = offsets.find(op.id); it != offsets.end()) {
+        scan.ns.push_back(time_ns([&] { allocator.free(it->second); }));
+        offsets.erase(it);
+      }
+      if (i % 1024 == 0)
+        scan.maxFragmentation = std::max(scan.maxFragmentation, allocator.fragmentation());
+    }
+  }
+
+  std::printf("%-6s %10s %10s %10s %10s %8s %10s\n", "", "mean ns", "p50 ns", "p99 ns", "total ms", "failed", "max frag");
+  print("tlsf", tlsf);
+  print("scan", scan);
+  std::printf(valid ? "valid\n" : "NOT valid\n");
+  return valid ? 0 : 1;
+}
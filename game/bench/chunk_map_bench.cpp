@@ -0,0 +1,139 @@
+// Lookup throughput of ChunkMap while a writer streams chunks in and out,
+// compared against std::unordered_map behind a std::shared_mutex.
+//
+// Mirrors how the game uses the table: reader threads (physics, raycasts)
+// only hold pointers within a frame, and collect() runs between frames.
+#include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+import glm;
+import chunk_map;
+
+namespace {
+
+constexpr int WORLD_RADIUS = 16;        // 33^3 candidate chunk positions
+constexpr int FRAMES = 200;
+constexpr auto FRAME_TIME = std::chrono::microseconds(2000);
+constexpr int WRITES_PER_FRAME = 256;   // insert-or-erase operations per frame
+
+struct FakeChunk {
+  glm::ivec3 pos;
+};
+
+glm::ivec3 random_pos(std::mt19937& rng) {
+  std::uniform_int_distribution<int> d(-WORLD_RADIUS, WORLD_RADIUS);
+  return { d(rng), d(rng), d(rng) };
+}
+
+class LockedMap {
+public:
+  FakeChunk* find(const glm::ivec3& pos) const {
+    std::shared_lock lock(mutex);
+    auto it = map.find(pos);
+    return it != map.end() ? it->second.get() : nullptr;
+  }
+  void insert(const glm::ivec3& pos, std::unique_ptr<FakeChunk> c) {
+    std::unique_lock lock(mutex);
+    map.try_emplace(pos, std::move(c));
+  }
+  void erase(const glm::ivec3& pos) {
+    std::unique_lock lock(mutex);
+    map.erase(pos);
+  }
+  void collect() {}
+
+private:
+  mutable std::shared_mutex mutex;
+  std::unordered_map<glm::ivec3, std::unique_ptr<FakeChunk>, ivec3_hash> map;
+};
+
+template <typename Map>
+double run(Map& map, unsigned readers) {
+  std::mt19937 seed_rng(42);
+  for (int i = 0; i < 20000; i++) {
+    glm::ivec3 p = random_pos(seed_rng);
+    map.insert(p, std::make_unique<FakeChunk>(p));
+  }
+
+  std::atomic<bool> frame_over{false};
+  std::atomic<std::uint64_t> lookups{0};
+  std::atomic<std::uint64_t> found{0};
+  std::barrier sync(readers + 2);
+
+  auto reader = [&](unsigned id) {
+    std::mt19937 rng(id + 1);
+    std::uint64_t local = 0, hits = 0;
+    for (int f = 0; f < FRAMES; f++) {
+      sync.arrive_and_wait();
+      while (!frame_over.load(std::memory_order_relaxed)) {
+        for (int i = 0; i < 64; i++)
+          hits += map.find(random_pos(rng)) != nullptr;
+        local += 64;
+      }
+      sync.arrive_and_wait();
+    }
+    lookups += local;
+    found += hits;
+  };
+
+  auto writer = [&]() {
+    std::mt19937 rng(7);
+    for (int f = 0; f < FRAMES; f++) {
+      sync.arrive_and_wait();
+      for (int i = 0; i < WRITES_PER_FRAME; i++) {
+        glm::ivec3 p = random_pos(rng);
+        if (rng() & 1)
+          map.insert(p, std::make_unique<FakeChunk>(p));
+        else
+          map.erase(p);
+      }
+      sync.arrive_and_wait();
+    }
+  };
+
+  std::vector<std::jthread> threads;
+  for (unsigned i = 0; i < readers; i++)
+    threads.emplace_back(reader, i);
+  threads.emplace_back(writer);
+
+  auto start = std::chrono::steady_clock::now();
+  for (int f = 0; f < FRAMES; f++) {
+    frame_over = false;
+    sync.arrive_and_wait();
+    std::this_thread::sleep_for(FRAME_TIME);
+    frame_over = true;
+    sync.arrive_and_wait();
+    map.collect();
+  }
+  threads.clear();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  return static_cast<double>(lookups.load()) / seconds / 1e6;
+}
+
+} // namespace
+
+int main() {
+  const unsigned max_readers = std::max(1u, std::thread::hardware_concurrency() - 1);
+
+  std::printf("%-8s %18s %18s\n", "readers", "ChunkMap Mlook/s", "locked map Mlook/s");
+  for (unsigned readers = 1; readers <= max_readers; readers *= 2) {
+    ChunkMap<FakeChunk> lockfree;
+    LockedMap locked;
+    double a = run(lockfree, readers);
+    double b = run(locked, readers);
+    std::printf("%-8u %18.2f %18.2f\n", readers, a, b);
+  }
+  return 0;
+}
@@ -0,0 +1,119 @@
+// 3D terrain noise for one padded chunk: full resolution (one FastNoise2 sample per voxel)
+// against coarse DensityField lattices upsampled trilinearly.
+//
+// Reports time per chunk, the interpolation error against the full-resolution noise and
+// how many voxels flip between solid and air for a surface like generate_terrain()'s
+// (height - y + noise * OVERHANG) crossing the chunk.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+import mesher;
+import noise_2;
+import density_field;
+
+namespace {
+
+constexpr int CHUNKS = 32;
+constexpr float FREQUENCY = 1.0f / 32.0f;
+constexpr float OVERHANG = 12.0f;
+constexpr int SURFACE = 31; // world y of the surface before the noise moves it
+
+struct Config {
+  const char* name;
+  int step_xz;
+  int step_y;
+};
+
+struct Result {
+  double ns_per_chunk = 0.0;
+  double mean_error = 0.0;
+  double max_error = 0.0;
+  double flipped = 0.0; // fraction of voxels
+};
+
+int chunk_x(int c) { return (c % 8) * CS - 1; }
+int chunk_z(int c) { return (c / 8) * CS - 1; }
+
+// reference[c] is the full-resolution noise of chunk c, [pz + CS_P * (px + CS_P * py)] like the voxels
+std::vector<std::vector<float>> full_resolution(Noise& noise, double& ns_per_chunk) {
+  std::vector<std::vector<float>> reference(CHUNKS, std::vector<float>(CS_P3));
+  std::vector<float> grid(CS_P3);
+
+  const auto start = std::chrono::steady_clock::now();
+  for (int c = 0; c < CHUNKS; c++) {
+    noise.gen_grid_3d(grid, chunk_x(c) * FREQUENCY, -1 * FREQUENCY, chunk_z(c) * FREQUENCY,
+        CS_P, CS_P, CS_P, FREQUENCY, FREQUENCY, FREQUENCY, 32);
+    for (int pz = 0; pz < CS_P; pz++)
+      for (int py = 0; py < CS_P; py++)
+        for (int px = 0; px < CS_P; px++)
+          reference[c][pz + CS_P * (px + CS_P * py)] = std::clamp(grid[px + CS_P * (py + CS_P * pz)], -1.0f, 1.0f);
+  }
+  ns_per_chunk = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / CHUNKS;
+  return reference;
+}
+
+Result run(Noise& noise, const Config& config, const std::vector<std::vector<float>>& reference) {
+  DensityField density(config.step_xz, config.step_y);
+  std::vector<std::vector<float>> upsampled(CHUNKS, std::vector<float>(CS_P3));
+
+  const auto start = std::chrono::steady_clock::now();
+  for (int c = 0; c < CHUNKS; c++) {
+    int lx, ly, lz;
+    density.align(chunk_x(c), -1, chunk_z(c), lx, ly, lz);
+    noise.gen_grid_3d(density.lattice(), lx * FREQUENCY, ly * FREQUENCY, lz * FREQUENCY,
+        density.count_xz(), density.count_y(), density.count_xz(),
+        density.step_xz() * FREQUENCY, density.step_y() * FREQUENCY, density.step_xz() * FREQUENCY, 32);
+    density.prepare();
+    for (int py = 0; py < CS_P; py++)
+      for (int px = 0; px < CS_P; px++)
+        density.upsample_row(px, py, &upsampled[c][CS_P * (px + CS_P * py)]);
+  }
+
+  Result result;
+  result.ns_per_chunk = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / CHUNKS;
+
+  long long flipped = 0;
+  double error_sum = 0.0;
+  for (int c = 0; c < CHUNKS; c++) {
+    for (int i = 0; i < CS_P3; i++) {
+      const float exact = reference[c][i], approx = upsampled[c][i];
+      const double error = std::abs(exact - approx);
+      error_sum += error;
+      result.max_error = std::max(result.max_error, error);
+
+      const float height = float(SURFACE - (i / CS_P2 - 1));
+      flipped += (height + exact * OVERHANG > 0.0f) != (height + approx * OVERHANG > 0.0f);
+    }
+  }
+  result.mean_error = error_sum / (double(CHUNKS) * CS_P3);
+  result.flipped = double(flipped) / (double(CHUNKS) * CS_P3);
+  return result;
+}
+
+} // namespace
+
+int main() {
+  Noise noise;
+
+  double full_ns = 0.0;
+  const std::vector<std::vector<float>> reference = full_resolution(noise, full_ns);
+
+  const Config configs[] = {
+    { "2x2x2", 2, 2 },
+    { "4x4x4", 4, 4 },
+    { "4x8x4", 4, 8 },
+    { "8x8x8", 8, 8 },
+  };
+
+  std::printf("%-8s %12s %9s %11s %11s %10s\n", "lattice", "us/chunk", "speedup", "mean err", "max err", "flipped");
+  std::printf("%-8s %12.1f %9.2f %11s %11s %10s\n", "full", full_ns / 1000.0, 1.0, "-", "-", "-");
+  for (const Config& config : configs) {
+    const Result r = run(noise, config, reference);
+    std::printf("%-8s %12.1f %9.2f %11.5f %11.5f %9.3f%%\n", config.name, r.ns_per_chunk / 1000.0,
+        full_ns / r.ns_per_chunk, r.mean_error, r.max_error, r.flipped * 100.0);
+  }
+  return 0;
+}
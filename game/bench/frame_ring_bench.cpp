@@ -0,0 +1,141 @@
+// FrameRing's bookkeeping against a mock GPU that finishes each retired region a fixed number
+// of frames after it was submitted: stalls per ring size and GPU lag, and the time per upload
+// (the checks below included).
+//
+//   xmake run bench_frame_ring
+//
+// Every allocation is checked: it has to lie in one region, not overlap anything else
+// handed out from that region since it was last acquired, and the GPU has to be done with the
+// region (its fence signalled) by the time it's handed out. Any failure is reported and the
+// process exits with 1, so this doubles as the ring's test.
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <optional>
+#include <random>
+#include <vector>
+
+import frame_ring;
+
+namespace {
+
+constexpr std::size_t REGION_BYTES = 1 << 20;
+constexpr int FRAMES = 20000;
+
+// Fences are submission serials, a fence is signalled once the GPU has completed that many
+// submissions. wait() makes the GPU catch up, like blocking on a real one would
+struct MockGpu {
+  std::uint64_t submitted = 0;
+  std::uint64_t completed = 0;
+  std::uint64_t waits = 0;
+};
+
+struct MockFences {
+  using Fence = std::uint64_t;
+  MockGpu* gpu = nullptr;
+
+  Fence insert() { return ++gpu->submitted; }
+  bool signalled(Fence fence) { return gpu->completed >= fence; }
+  void wait(Fence fence) {
+    gpu->waits++;
+    gpu->completed = std::max(gpu->completed, fence);
+  }
+  void release(Fence) {}
+};
+
+struct Result {
+  FrameRingStats stats;
+  std::uint64_t allocations = 0;
+  double ns = 0.0;
+};
+
+// FRAMES frames of uploads, a random number of them of up to a quarter of a region each (so
+// regions fill up mid-frame too), with the GPU `lag` submissions behind at the start of every frame
+Result run(std::size_t regions, std::uint64_t lag, bool& valid) {
+  MockGpu gpu;
+  FrameRing<MockFences> ring(REGION_BYTES, regions, MockFences{ &gpu });
+  std::mt19937 rng(static_cast<unsigned>(regions * 31 + lag));
+
+  // Per region, the submission it was last retired with and what's handed out since
+  std::vector<std::uint64_t> retiredWith(regions, 0);
+  std::vector<std::vector<std::pair<std::size_t, std::size_t>>> live(regions);
+  std::size_t lastRegion = ring.region();
+
+  Result result;
+  const auto start = std::chrono::steady_clock::now();
+  for (int frame = 0; frame < FRAMES && valid; frame++) {
+    gpu.completed = std::max(gpu.completed, gpu.submitted > lag ? gpu.submitted - lag : 0);
+
+    const int uploads = rng() % 12;
+    for (int i = 0; i < uploads; i++) {
+      const std::size_t bytes = 8 * (1 + rng() % (REGION_BYTES / 8 / 4));
+      const std::size_t regionBefore = ring.region();
+      const std::uint64_t submittedBefore = gpu.submitted;
+      const std::optional<std::size_t> offset = ring.allocate(bytes, 8);
+      result.allocations++;
+      if (!offset) {
+        std::printf("frame %d: %zu bytes didn't fit in an empty region\n", frame, bytes);
+        valid = false;
+        break;
+      }
+
+      const std::size_t region = *offset / REGION_BYTES;
+      if (gpu.submitted != submittedBefore) // the region filled up and was retired
+        retiredWith[regionBefore] = gpu.submitted;
+      if (region != lastRegion || gpu.submitted != submittedBefore)
+        live[region].clear();
+      lastRegion = region;
+
+      const std::size_t begin = *offset % REGION_BYTES;
+      const bool outside = region != ring.region() || begin + bytes > REGION_BYTES || *offset % 8 != 0;
+      const bool overlaps = std::any_of(live[region].begin(), live[region].end(),
+          [&](const auto& range) { return begin < range.second && range.first < begin + bytes; });
+      const bool busy = gpu.completed < retiredWith[region];
+      if (outside || overlaps || busy) {
+        std::printf("frame %d: %zu bytes at %zu in region %zu: %s\n", frame, bytes, *offset, region,
+            outside ? "outside the region" : overlaps ? "overlaps" : "the GPU may still read it");
+        valid = false;
+        break;
+      }
+      live[region].push_back({ begin, begin + bytes });
+    }
+
+    const std::size_t region = ring.region();
+    const std::uint64_t submittedBefore = gpu.submitted;
+    ring.retire();
+    if (gpu.submitted != submittedBefore) {
+      retiredWith[region] = gpu.submitted;
+      live[region].clear();
+    }
+  }
+  result.ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+  result.stats = ring.get_stats();
+
+  // Every stall has to be one of the mock's waits, and the other way round
+  if (result.stats.stalls != gpu.waits) {
+    std::printf("%zu regions, lag %llu: %llu stalls counted, %llu waits\n", regions,
+        static_cast<unsigned long long>(lag), static_cast<unsigned long long>(result.stats.stalls),
+        static_cast<unsigned long long>(gpu.waits));
+    valid = false;
+  }
+  return result;
+}
+
+} // namespace
+
+int main() {
+  bool valid = true;
+  std::printf("%8s %5s %10s %10s %10s %12s\n", "regions", "lag", "retired", "stalls", "stall %", "ns/upload");
+  for (std::size_t regions = 1; regions <= 4; regions++) {
+    for (std::uint64_t lag = 0; lag <= 3; lag++) {
+      const Result result = run(regions, lag, valid);
+      std::printf("%8zu %5llu %10llu %10llu %9.1f%% %12.1f\n", regions, static_cast<unsigned long long>(lag),
+          static_cast<unsigned long long>(result.stats.retired), static_cast<unsigned long long>(result.stats.stalls),
+          result.stats.retired ? 100.0 * result.stats.stalls / result.stats.retired : 0.0,
+          result.allocations ? result.ns / result.allocations : 0.0);
+    }
+  }
+  std::printf(valid ? "valid\n" : "NOT valid\n");
+  return valid ? 0 : 1;
+}
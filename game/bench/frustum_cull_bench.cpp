@@ -0,0 +1,148 @@
+// Frustum culling of chunk bounds: the AVX2 kernel against the scalar one, at 10k to 100k
+// chunks of a square world seen by a camera turning on the spot.
+//
+//   xmake run bench_frustum_cull
+//
+// Every mask is also checked bit for bit against the per-box test ChunkManager uses for
+// streaming (isAABBInsideFrustum()); any mismatch is reported and the process exits with 1,
+// so this doubles as the kernels' test.
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+import frustum_cull;
+
+namespace {
+
+constexpr float CHUNK = 62.0f;
+constexpr int VIEWS = 64;
+constexpr int RUNS = 20;
+
+// A 90 degree frustum at the origin looking along yaw / pitch, 40 chunks deep
+CullPlanes make_frustum(float yaw, float pitch) {
+  const float forward[3] = { std::cos(pitch) * std::cos(yaw), std::sin(pitch), std::cos(pitch) * std::sin(yaw) };
+  const float right[3] = { -std::sin(yaw), 0.0f, std::cos(yaw) };
+  const float up[3] = { right[1] * forward[2] - right[2] * forward[1], right[2] * forward[0] - right[0] * forward[2],
+    right[0] * forward[1] - right[1] * forward[0] };
+
+  const auto plane = [](const float (&a)[3], const float (&b)[3], float sign, float offset) {
+    float n[3];
+    for (int i = 0; i < 3; i++)
+      n[i] = a[i] + sign * b[i];
+    const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    return CullPlane{ { n[0] / length, n[1] / length, n[2] / length }, offset };
+  };
+  const float zero[3] = {};
+  return {
+    plane(forward, right, 1.0f, 0.0f),
+    plane(forward, right, -1.0f, 0.0f),
+    plane(forward, up, 1.0f, 0.0f),
+    plane(forward, up, -1.0f, 0.0f),
+    plane(forward, zero, 0.0f, -0.1f),
+    plane(zero, forward, -1.0f, 40.0f * CHUNK),
+  };
+}
+
+// Columns of 8 chunks on a square around the origin, in shuffled order like rows end up
+// after some streaming
+ChunkBounds make_bounds(std::size_t count, std::mt19937& rng) {
+  const int side = static_cast<int>(std::ceil(std::sqrt(double(count) / 8.0)));
+  std::vector<std::array<int, 3>> chunks;
+  for (int x = 0; x < side; x++)
+    for (int z = 0; z < side; z++)
+      for (int y = -4; y < 4; y++)
+        chunks.push_back({ x - side / 2, y, z - side / 2 });
+  std::shuffle(chunks.begin(), chunks.end(), rng);
+  chunks.resize(count);
+
+  ChunkBounds bounds;
+  for (const auto& chunk : chunks) {
+    float min[3], max[3];
+    for (int axis = 0; axis < 3; axis++) {
+      min[axis] = chunk[axis] * CHUNK;
+      max[axis] = min[axis] + CHUNK;
+    }
+    bounds.push_back(min, max);
+  }
+  return bounds;
+}
+
+// What ChunkManager::isAABBInsideFrustum() does for one box
+bool inside_frustum(const ChunkBounds& bounds, std::size_t row, const CullPlanes& planes) {
+  for (const CullPlane& plane : planes) {
+    float p[3];
+    for (int axis = 0; axis < 3; axis++)
+      p[axis] = plane.normal[axis] >= 0 ? bounds.max(axis)[row] : bounds.min(axis)[row];
+    if (plane.normal[0] * p[0] + plane.normal[1] * p[1] + plane.normal[2] * p[2] + plane.offset < 0)
+      return false;
+  }
+  return true;
+}
+
+// Mean nanoseconds per chunk over every view, RUNS times
+template <typename Kernel>
+double time_per_chunk(const ChunkBounds& bounds, const std::vector<CullPlanes>& views, std::uint64_t* visible,
+    Kernel&& kernel) {
+  const auto start = std::chrono::steady_clock::now();
+  for (int run = 0; run < RUNS; run++)
+    for (const CullPlanes& view : views)
+      kernel(bounds, view, visible);
+  const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+  return ns / (double(RUNS) * views.size() * bounds.size());
+}
+
+} // namespace
+
+int main() {
+  std::mt19937 rng(42);
+  std::vector<CullPlanes> views;
+  for (int view = 0; view < VIEWS; view++)
+    views.push_back(make_frustum(view * 6.2831853f / VIEWS, std::sin(view * 0.7f) * 0.6f));
+
+#if (defined(__x86_64__) || defined(_M_X64)) && (defined(__GNUC__) || defined(__clang__))
+  const bool avx2 = __builtin_cpu_supports("avx2");
+#else
+  const bool avx2 = false;
+#endif
+  std::printf("kernels: %s\n", avx2 ? "AVX2" : "scalar");
+  std::printf("%8s %12s %12s %9s %9s\n", "chunks", "scalar ns", "simd ns", "speedup", "visible");
+
+  bool valid = true;
+  for (const std::size_t count : { 10000u, 25000u, 50000u, 100000u }) {
+    const ChunkBounds bounds = make_bounds(count, rng);
+    std::vector<std::uint64_t> scalar(cull_mask_words(count)), simd(cull_mask_words(count));
+
+    std::size_t visible = 0;
+    for (const CullPlanes& view : views) {
+      cull_bounds_scalar(bounds, view, scalar.data());
+      cull_bounds(bounds, view, simd.data());
+      for (std::size_t row = 0; row < count; row++) {
+        const bool expected = inside_frustum(bounds, row, view);
+        const bool fromScalar = scalar[row / 64] >> (row % 64) & 1;
+        const bool fromSimd = simd[row / 64] >> (row % 64) & 1;
+        if (fromScalar != expected || fromSimd != expected) {
+          std::printf("%zu chunks, row %zu: expected %d, scalar %d, simd %d\n", count, row, expected, fromScalar,
+              fromSimd);
+          valid = false;
+          break;
+        }
+        visible += expected;
+      }
+    }
+
+    const double scalarNs = time_per_chunk(bounds, views, scalar.data(),
+        [](const ChunkBounds& b, const CullPlanes& p, std::uint64_t* v) { cull_bounds_scalar(b, p, v); });
+    const double simdNs = time_per_chunk(bounds, views, simd.data(),
+        [](const ChunkBounds& b, const CullPlanes& p, std::uint64_t* v) { cull_bounds(b, p, v); });
+    std::printf("%8zu %12.3f %12.3f %8.2fx %8.1f%%\n", count, scalarNs, simdNs, scalarNs / simdNs,
+        100.0 * visible / (double(count) * views.size()));
+  }
+
+  std::printf(valid ? "valid\n" : "NOT valid\n");
+  return valid ? 0 : 1;
+}
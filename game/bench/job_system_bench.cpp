@@ -0,0 +1,96 @@
+// Chunk generation throughput (fill + mesh + hand-off through the completion queue)
+// on the JobSystem with 1..N workers.
+//
+// Terrain is a cheap hashed heightfield rather than FastNoise2 so the bench has no
+// dependencies beyond the mesher; the mesher dominates the per-chunk cost either way.
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+import mesher;
+import job_system;
+
+namespace {
+
+constexpr int CHUNKS = 512;
+
+struct Scratch {
+  std::unique_ptr<uint8_t[]> voxels{ new uint8_t[CS_P3] };
+  std::unique_ptr<uint64_t[]> opaqueMask{ new uint64_t[CS_P2] };
+  std::unique_ptr<MeshArena> arena = std::make_unique<MeshArena>();
+};
+
+struct Result {
+  int chunk;
+  int quads;
+};
+
+std::uint32_t hash(std::uint32_t x) {
+  x ^= x >> 16; x *= 0x7feb352du;
+  x ^= x >> 15; x *= 0x846ca68bu;
+  x ^= x >> 16;
+  return x;
+}
+
+void generate(int chunk, Scratch& s) {
+  std::memset(s.voxels.get(), 0, CS_P3);
+  std::memset(s.opaqueMask.get(), 0, CS_P2 * sizeof(uint64_t));
+  for (int x = 1; x <= CS; x++) {
+    for (int z = 1; z <= CS; z++) {
+      const int height = 20 + static_cast<int>(hash(chunk * 7919u + x * 131u + z) % 24);
+      for (int y = 1; y <= height; y++) {
+        s.voxels[z + x * CS_P + y * CS_P2] = y == height ? 3 : y > height - 3 ? 2 : 1;
+        s.opaqueMask[y * CS_P + x] |= 1ull << z;
+      }
+    }
+  }
+  mesh(s.voxels.get(), s.opaqueMask.get(), s.arena->data());
+}
+
+double run(unsigned workers) {
+  JobSystem jobs(workers);
+  std::vector<Scratch> scratch(workers);
+  CompletionQueue<Result> done;
+
+  const auto start = std::chrono::steady_clock::now();
+  for (int c = 0; c < CHUNKS; c++) {
+    jobs.submit([&, c](unsigned worker) {
+      generate(c, scratch[worker]);
+      done.push({ c, scratch[worker].arena->quadCount() });
+    });
+  }
+
+  // Drain like the frame loop would, until every chunk came back
+  int received = 0;
+  long long quads = 0;
+  while (received < CHUNKS) {
+    received += static_cast<int>(done.drain([&](Result&& r) { quads += r.quads; }));
+    std::this_thread::yield();
+  }
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  if (quads == 0)
+    std::printf("no quads?\n");
+  return CHUNKS / seconds;
+}
+
+} // namespace
+
+int main() {
+  const unsigned max_workers = std::max(1u, std::thread::hardware_concurrency());
+
+  std::printf("%-8s %12s %10s\n", "workers", "chunks/s", "speedup");
+  double base = 0.0;
+  for (unsigned workers = 1; workers <= max_workers; workers = workers < 4 ? workers + 1 : workers * 2) {
+    const double rate = run(workers);
+    if (workers == 1)
+      base = rate;
+    std::printf("%-8u %12.1f %10.2f\n", workers, rate, rate / base);
+  }
+  return 0;
+}
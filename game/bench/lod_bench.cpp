@@ -0,0 +1,87 @@
+// Quads and mesh bytes of downsampled (LOD) meshes against full detail, per chunk and per
+// distance ring, on synthetic rolling terrain.
+//
+// The rings use the default LodSettings and count one surface chunk per column inside the
+// render distance, which is where nearly all quads of real terrain are.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+import mesher;
+import lod;
+
+namespace {
+
+constexpr int SAMPLES = 16;
+constexpr int RENDER_DISTANCE = 30;
+
+// Smooth hills with a grass top, different for every sample
+void make_terrain(int sample, std::vector<uint8_t>& voxels) {
+  std::fill(voxels.begin(), voxels.end(), 0);
+  const float ox = sample * 37.0f, oz = sample * 53.0f;
+  for (int x = 0; x < CS_P; x++) {
+    for (int z = 0; z < CS_P; z++) {
+      const float wx = ox + x, wz = oz + z;
+      const float h = 30.0f + 12.0f * std::sin(wx * 0.07f) * std::cos(wz * 0.05f) + 4.0f * std::sin((wx + wz) * 0.21f);
+      const int height = static_cast<int>(h);
+      for (int y = 0; y < height && y < CS_P; y++)
+        voxels[z + x * CS_P + y * CS_P2] = y == height - 1 ? 3 : y > height - 4 ? 2 : 1;
+    }
+  }
+}
+
+} // namespace
+
+int main() {
+  std::vector<uint8_t> voxels(CS_P3);
+  std::unique_ptr<uint64_t[]> opaqueMask(new uint64_t[CS_P2]);
+  std::unique_ptr<uint8_t[]> scratchVoxels(new uint8_t[CS_P3]);
+  std::unique_ptr<uint64_t[]> scratchMask(new uint64_t[CS_P2]);
+  MeshArena arena;
+
+  double quads[MAX_LOD + 1] = {}, ns[MAX_LOD + 1] = {};
+  for (int sample = 0; sample < SAMPLES; sample++) {
+    make_terrain(sample, voxels);
+    buildOpaqueMask(voxels.data(), opaqueMask.get());
+    for (int lod = 0; lod <= MAX_LOD; lod++) {
+      const auto start = std::chrono::steady_clock::now();
+      mesh_lod(voxels.data(), opaqueMask.get(), lod, arena, scratchVoxels.get(), scratchMask.get());
+      ns[lod] += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+      quads[lod] += arena.quadCount();
+    }
+  }
+
+  std::printf("%-4s %6s %12s %10s %10s\n", "lod", "factor", "quads/chunk", "KB/chunk", "mesh us");
+  for (int lod = 0; lod <= MAX_LOD; lod++) {
+    quads[lod] /= SAMPLES;
+    std::printf("%-4d %5dx %12.0f %10.1f %10.1f\n", lod, lod_factor(lod), quads[lod],
+        quads[lod] * sizeof(uint64_t) / 1024.0, ns[lod] / SAMPLES / 1000.0);
+  }
+
+  const LodSettings settings;
+  int columns[MAX_LOD + 1] = {};
+  for (int x = -RENDER_DISTANCE; x <= RENDER_DISTANCE; x++) {
+    for (int z = -RENDER_DISTANCE; z <= RENDER_DISTANCE; z++) {
+      const float distance = std::sqrt(float(x * x + z * z));
+      if (distance <= RENDER_DISTANCE)
+        columns[lod_for_distance(settings, distance)]++;
+    }
+  }
+
+  std::printf("\nrender distance %d\n", RENDER_DISTANCE);
+  std::printf("%-4s %8s %12s %12s %10s\n", "ring", "columns", "full KB", "lod KB", "saved");
+  double fullTotal = 0.0, lodTotal = 0.0;
+  for (int lod = 0; lod <= MAX_LOD; lod++) {
+    const double full = columns[lod] * quads[0] * sizeof(uint64_t) / 1024.0;
+    const double scaled = columns[lod] * quads[lod] * sizeof(uint64_t) / 1024.0;
+    fullTotal += full;
+    lodTotal += scaled;
+    std::printf("%-4d %8d %12.0f %12.0f %9.0f%%\n", lod, columns[lod], full, scaled, full > 0.0 ? 100.0 * (1.0 - scaled / full) : 0.0);
+  }
+  std::printf("%-4s %8s %12.0f %12.0f %9.0f%%\n", "all", "", fullTotal, lodTotal, 100.0 * (1.0 - lodTotal / fullTotal));
+  return 0;
+}
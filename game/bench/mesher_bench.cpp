@@ -0,0 +1,162 @@
+// mesh() on canonical inputs at every instantiated chunk size (16, 30, 62), as JSON on stdout
+// so runs can be diffed and tracked: ns per voxel, quads per second and the p50 / p99 / mean
+// latency of one call. The opaque masks are built beforehand; only mesh() is timed.
+//
+//   xmake run bench_mesher [runs]   (default 200 timed runs per input)
+//
+// The inputs cover the extremes and the common case:
+//   empty, full        nothing to mesh: the cost of culling alone
+//   flat               one plane of grass, everything merges
+//   noise              rolling fractal-noise hills with dirt and grass layers
+//   checkerboard       3D checkerboard, every face visible and nothing merges (MAX_QUADS)
+//   random             half air, random types, little merging
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+import mesher;
+
+namespace {
+
+constexpr int WARMUP = 5;
+
+const char* simd_name(MesherSimd simd) {
+  switch (simd) {
+  case MesherSimd::AVX2: return "AVX2";
+  case MesherSimd::NEON: return "NEON";
+  default: return "scalar";
+  }
+}
+
+// Smooth value noise in [0, 1] on an integer lattice, a few octaves
+float lattice(int x, int z) {
+  uint32_t h = static_cast<uint32_t>(x) * 0x8da6b343u ^ static_cast<uint32_t>(z) * 0xd8163841u;
+  h = (h ^ (h >> 15)) * 0x2c1b3c6du;
+  h ^= h >> 12;
+  return (h & 0xffff) / 65535.0f;
+}
+
+float value_noise(float x, float z) {
+  const int x0 = static_cast<int>(std::floor(x)), z0 = static_cast<int>(std::floor(z));
+  const float fx = x - x0, fz = z - z0;
+  const float sx = fx * fx * (3.0f - 2.0f * fx), sz = fz * fz * (3.0f - 2.0f * fz);
+  const float a = lattice(x0, z0) + sx * (lattice(x0 + 1, z0) - lattice(x0, z0));
+  const float b = lattice(x0, z0 + 1) + sx * (lattice(x0 + 1, z0 + 1) - lattice(x0, z0 + 1));
+  return a + sz * (b - a);
+}
+
+float fractal_noise(float x, float z) {
+  float sum = 0.0f, amplitude = 0.5f, frequency = 1.0f / 24.0f;
+  for (int octave = 0; octave < 4; octave++) {
+    sum += amplitude * value_noise(x * frequency, z * frequency);
+    amplitude *= 0.5f;
+    frequency *= 2.0f;
+  }
+  return sum / 0.9375f;
+}
+
+struct Input {
+  const char* name;
+  std::vector<uint8_t> voxels;
+};
+
+// The inputs for a padded grid of side `cs_p`, ZXY like the chunks
+std::vector<Input> make_inputs(int cs_p) {
+  const int cs_p2 = cs_p * cs_p;
+  const auto at = [cs_p, cs_p2](int x, int y, int z) { return z + x * cs_p + y * cs_p2; };
+  std::vector<Input> inputs;
+  const auto add = [&inputs, cs_p, cs_p2](const char* name) -> std::vector<uint8_t>& {
+    return inputs.emplace_back(Input{ name, std::vector<uint8_t>(cs_p2 * cs_p) }).voxels;
+  };
+
+  add("empty");
+
+  std::vector<uint8_t>& full = add("full");
+  std::fill(full.begin(), full.end(), 1);
+
+  std::vector<uint8_t>& flat = add("flat");
+  for (int y = 0; y < cs_p / 2; y++)
+    for (int x = 0; x < cs_p; x++)
+      for (int z = 0; z < cs_p; z++)
+        flat[at(x, y, z)] = y == cs_p / 2 - 1 ? 3 : 1;
+
+  std::vector<uint8_t>& noise = add("noise");
+  for (int x = 0; x < cs_p; x++) {
+    for (int z = 0; z < cs_p; z++) {
+      const int height = static_cast<int>(fractal_noise(float(x), float(z)) * cs_p);
+      for (int y = 0; y < height && y < cs_p; y++)
+        noise[at(x, y, z)] = y == height - 1 ? 3 : y > height - 4 ? 2 : 1;
+    }
+  }
+
+  std::vector<uint8_t>& checkerboard = add("checkerboard");
+  for (int y = 0; y < cs_p; y++)
+    for (int x = 0; x < cs_p; x++)
+      for (int z = 0; z < cs_p; z++)
+        checkerboard[at(x, y, z)] = (x + y + z) & 1 ? 1 : 0;
+
+  std::mt19937 rng(1234);
+  std::vector<uint8_t>& random = add("random");
+  for (uint8_t& v : random)
+    v = rng() % 2 ? static_cast<uint8_t>(1 + rng() % 8) : 0;
+
+  return inputs;
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+  const std::size_t i = static_cast<std::size_t>(p * (sorted.size() - 1) + 0.5);
+  return sorted[std::min(i, sorted.size() - 1)];
+}
+
+template <int Size>
+void run(int runs, bool& first) {
+  using M = Mesher<Size>;
+  std::vector<MeshMask<Size>> opaqueMask(M::CS_P2);
+  BasicMeshArena<Size> arena;
+  std::vector<double> ns(runs);
+
+  for (const Input& input : make_inputs(M::CS_P)) {
+    const uint8_t* voxels = input.voxels.data();
+    buildOpaqueMask<Size>(voxels, opaqueMask.data());
+    for (int i = 0; i < WARMUP; i++)
+      mesh(voxels, opaqueMask.data(), arena.data());
+
+    for (int i = 0; i < runs; i++) {
+      const auto start = std::chrono::steady_clock::now();
+      mesh(voxels, opaqueMask.data(), arena.data());
+      ns[i] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    }
+    double mean = 0.0;
+    for (double t : ns)
+      mean += t;
+    mean /= runs;
+    std::vector<double> sorted = ns;
+    std::sort(sorted.begin(), sorted.end());
+
+    const int quads = arena.quadCount();
+    std::printf("%s\n    {\"size\": %d, \"input\": \"%s\", \"quads\": %d, \"ns_per_voxel\": %.3f, "
+        "\"quads_per_s\": %.0f, \"p50_ns\": %.0f, \"p99_ns\": %.0f, \"mean_ns\": %.0f}",
+        first ? "" : ",", Size, input.name, quads, mean / (M::CS * M::CS * M::CS),
+        quads / (mean * 1e-9), percentile(sorted, 0.50), percentile(sorted, 0.99), mean);
+    first = false;
+  }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+  const int runs = argc > 1 ? std::max(1, std::atoi(argv[1])) : 200;
+
+  std::printf("{\n  \"kernels\": \"%s\",\n  \"runs\": %d,\n  \"results\": [", simd_name(mesherSimd()), runs);
+  bool first = true;
+  run<16>(runs, first);
+  run<30>(runs, first);
+  run<62>(runs, first);
+  std::printf("\n  ]\n}\n");
+  return 0;
+}
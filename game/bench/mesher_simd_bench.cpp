@@ -0,0 +1,109 @@
+// SIMD kernels of the mesher (hidden face culling, opaque mask construction) against the
+// scalar code, on random, sparse, solid and terrain-like grids.
+//
+// Every grid is first checked for bit-exact equality with the scalar result; any mismatch
+// is reported and the process exits with 1, so this doubles as the kernels' test.
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+import mesher;
+
+namespace {
+
+constexpr int ITERATIONS = 2000;
+
+const char* simd_name(MesherSimd simd) {
+  switch (simd) {
+  case MesherSimd::AVX2: return "AVX2";
+  case MesherSimd::NEON: return "NEON";
+  default: return "scalar";
+  }
+}
+
+struct Grid {
+  const char* name;
+  std::vector<uint8_t> voxels = std::vector<uint8_t>(CS_P3);
+};
+
+std::vector<Grid> make_grids() {
+  std::mt19937 rng(1234);
+  std::vector<Grid> grids;
+
+  Grid& random = grids.emplace_back(Grid{ "random" });
+  for (uint8_t& v : random.voxels)
+    v = rng() % 2 ? static_cast<uint8_t>(1 + rng() % 4) : 0;
+
+  Grid& sparse = grids.emplace_back(Grid{ "sparse" });
+  for (uint8_t& v : sparse.voxels)
+    v = rng() % 64 == 0 ? 1 : 0;
+
+  Grid& solid = grids.emplace_back(Grid{ "solid" });
+  std::memset(solid.voxels.data(), 3, CS_P3);
+
+  Grid& terrain = grids.emplace_back(Grid{ "terrain" });
+  for (int x = 0; x < CS_P; x++) {
+    for (int z = 0; z < CS_P; z++) {
+      const int height = 16 + static_cast<int>(rng() % 32);
+      for (int y = 0; y < height; y++)
+        terrain.voxels[z + x * CS_P + y * CS_P2] = y == height - 1 ? 3 : 1;
+    }
+  }
+  return grids;
+}
+
+template <typename Fn>
+double time_ns(Fn&& fn) {
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < ITERATIONS; i++)
+    fn();
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / ITERATIONS;
+}
+
+} // namespace
+
+int main() {
+  std::unique_ptr<uint64_t[]> maskScalar(new uint64_t[CS_P2]);
+  std::unique_ptr<uint64_t[]> maskSimd(new uint64_t[CS_P2]);
+  std::unique_ptr<uint64_t[]> facesScalar(new uint64_t[CS_2 * 6]);
+  std::unique_ptr<uint64_t[]> facesSimd(new uint64_t[CS_2 * 6]);
+
+  std::printf("kernels: %s\n", simd_name(mesherSimd()));
+  std::printf("%-8s %-12s %12s %12s %9s\n", "grid", "kernel", "scalar ns", "simd ns", "speedup");
+
+  bool exact = true;
+  for (const Grid& grid : make_grids()) {
+    const uint8_t* voxels = grid.voxels.data();
+
+    buildOpaqueMaskScalar(voxels, maskScalar.get());
+    buildOpaqueMask(voxels, maskSimd.get());
+    if (std::memcmp(maskScalar.get(), maskSimd.get(), CS_P2 * sizeof(uint64_t)) != 0) {
+      std::printf("%-8s opaque mask MISMATCH\n", grid.name);
+      exact = false;
+    }
+
+    std::memset(facesScalar.get(), 0, CS_2 * 6 * sizeof(uint64_t));
+    std::memset(facesSimd.get(), 0xff, CS_2 * 6 * sizeof(uint64_t));
+    cullFacesScalar(maskScalar.get(), facesScalar.get());
+    cullFaces(maskScalar.get(), facesSimd.get());
+    if (std::memcmp(facesScalar.get(), facesSimd.get(), CS_2 * 6 * sizeof(uint64_t)) != 0) {
+      std::printf("%-8s face masks MISMATCH\n", grid.name);
+      exact = false;
+    }
+
+    const double maskScalarNs = time_ns([&] { buildOpaqueMaskScalar(voxels, maskScalar.get()); });
+    const double maskSimdNs = time_ns([&] { buildOpaqueMask(voxels, maskSimd.get()); });
+    std::printf("%-8s %-12s %12.0f %12.0f %9.2f\n", grid.name, "opaque mask", maskScalarNs, maskSimdNs, maskScalarNs / maskSimdNs);
+
+    const double cullScalarNs = time_ns([&] { cullFacesScalar(maskScalar.get(), facesScalar.get()); });
+    const double cullSimdNs = time_ns([&] { cullFaces(maskScalar.get(), facesSimd.get()); });
+    std::printf("%-8s %-12s %12.0f %12.0f %9.2f\n", grid.name, "face culling", cullScalarNs, cullSimdNs, cullScalarNs / cullSimdNs);
+  }
+
+  std::printf(exact ? "bit-exact\n" : "NOT bit-exact\n");
+  return exact ? 0 : 1;
+}
@@ -0,0 +1,157 @@
+// Quad buffer bytes of the 8 byte quads against the 4 byte COMPACT_QUADS ones, per chunk and
+// for a loaded world, on synthetic terrain with a handful of block types; and the time
+// compact_quads() takes per quad. Both formats are measured whatever the build's is.
+//
+//   xmake run bench_quad_format
+//
+// The world counts one surface chunk per column inside the render distance, like bench_lod.
+// Every compact mesh is also checked against the mesh it was packed from: drawn out face by
+// face, the two have to cover the same cells with the same block types. Any difference is
+// reported and the process exits with 1, so this doubles as the packing's test.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+import mesher;
+import quad_format;
+
+namespace {
+
+constexpr int SAMPLES = 16;
+constexpr int RUNS = 20; // of the packing per sample, for the timing
+constexpr int RENDER_DISTANCE = 30;
+constexpr int GRID = CS + 1; // quad positions run from 0 to CS
+
+// Hills over stone with dirt and grass on top, sand below "sea level" and the odd column of
+// wood, different for every sample
+void make_terrain(int sample, std::vector<uint8_t>& voxels) {
+  std::fill(voxels.begin(), voxels.end(), 0);
+  const float ox = sample * 37.0f, oz = sample * 53.0f;
+  for (int x = 0; x < CS_P; x++) {
+    for (int z = 0; z < CS_P; z++) {
+      const float wx = ox + x, wz = oz + z;
+      const float h = 30.0f + 12.0f * std::sin(wx * 0.07f) * std::cos(wz * 0.05f) + 4.0f * std::sin((wx + wz) * 0.21f);
+      const int height = static_cast<int>(h);
+      const bool tree = (x * 7 + z * 13 + sample) % 97 == 0;
+      for (int y = 0; y < std::min(tree ? height + 5 : height, CS_P); y++) {
+        uint8_t type = 3; // stone
+        if (y >= height)
+          type = 6; // wood
+        else if (height < 26)
+          type = y > height - 3 ? 8 : 3; // sand
+        else if (y == height - 1)
+          type = 2; // grass
+        else if (y > height - 4)
+          type = 1; // dirt
+        voxels[z + x * CS_P + y * CS_P2] = type;
+      }
+    }
+  }
+}
+
+// Writes the block type of every cell the quad covers into cells (GRID^3), false if a cell was
+// covered already or the quad reaches outside
+bool draw_quad(std::uint64_t quad, int face, std::vector<uint8_t>& cells) {
+  constexpr int FLIP[6] = { 1, -1, -1, 1, -1, 1 };
+  const int wAxis = (face & 2) >> 1, hAxis = 2 - (face >> 2);
+  const int pos[3] = { int(quad & 63), int(quad >> 6 & 63), int(quad >> 12 & 63) };
+  const int w = int(quad >> 18 & 63), h = int(quad >> 24 & 63);
+  const int wBegin = FLIP[face] > 0 ? pos[wAxis] : pos[wAxis] - w;
+  if (wBegin < 0 || wBegin + w > GRID || pos[hAxis] + h > GRID)
+    return false;
+
+  for (int i = 0; i < w; i++) {
+    for (int j = 0; j < h; j++) {
+      int cell[3] = { pos[0], pos[1], pos[2] };
+      cell[wAxis] = wBegin + i;
+      cell[hAxis] += j;
+      uint8_t& out = cells[cell[0] + GRID * (cell[1] + GRID * cell[2])];
+      if (out != 0)
+        return false;
+      out = static_cast<uint8_t>(quad >> 32);
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+int main() {
+  std::vector<uint8_t> voxels(CS_P3);
+  std::unique_ptr<uint64_t[]> opaqueMask(new uint64_t[CS_P2]);
+  MeshArena arena;
+  std::vector<std::uint32_t> compact;
+  std::vector<uint8_t> expected(GRID * GRID * GRID), packed(GRID * GRID * GRID);
+
+  bool valid = true;
+  double quads = 0.0, compactQuads = 0.0, paletteTypes = 0.0, ns = 0.0;
+  for (int sample = 0; sample < SAMPLES; sample++) {
+    make_terrain(sample, voxels);
+    buildOpaqueMask(voxels.data(), opaqueMask.get());
+    mesh(voxels.data(), opaqueMask.get(), arena.data());
+    const MeshData& data = arena.data();
+    quads += arena.quadCount();
+
+    QuadPalette palette;
+    int faceCount[6];
+    int total = 0;
+    compact.resize(std::size_t(arena.quadCount()) * 4);
+    const auto start = std::chrono::steady_clock::now();
+    for (int run = 0; run < RUNS; run++) {
+      palette = build_palette(data.vertices, data.faceVertexBegin, data.faceVertexLength);
+      total = 0;
+      for (int face = 0; face < 6; face++) {
+        faceCount[face] = compact_quads(data.vertices + data.faceVertexBegin[face], data.faceVertexLength[face], face,
+            palette, compact.data() + total);
+        total += faceCount[face];
+      }
+    }
+    ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / RUNS;
+    compactQuads += total;
+    paletteTypes += std::count_if(std::begin(palette.types), std::end(palette.types), [](uint8_t t) { return t != 0; });
+
+    for (int face = 0, begin = 0; face < 6 && valid; begin += faceCount[face], face++) {
+      std::fill(expected.begin(), expected.end(), 0);
+      std::fill(packed.begin(), packed.end(), 0);
+      for (int i = data.faceVertexBegin[face]; i < data.faceVertexBegin[face] + data.faceVertexLength[face]; i++)
+        draw_quad(data.vertices[i], face, expected);
+      for (int i = begin; i < begin + faceCount[face] && valid; i++) {
+        if (!draw_quad(expand_quad(compact[i], palette), face, packed)) {
+          std::printf("sample %d face %d: compact quad %d overlaps another or reaches outside the chunk\n", sample, face,
+              i - begin);
+          valid = false;
+        }
+      }
+      if (valid && packed != expected) {
+        std::printf("sample %d face %d: compact quads don't cover the same cells\n", sample, face);
+        valid = false;
+      }
+    }
+  }
+  quads /= SAMPLES;
+  compactQuads /= SAMPLES;
+  paletteTypes /= SAMPLES;
+
+  // The palette is a DrawTable row's and goes out with each of the chunk's draws every frame,
+  // it's not in the quad buffer
+  const double fullKB = quads * 8 / 1024.0, compactKB = compactQuads * 4 / 1024.0;
+  std::printf("%-8s %12s %10s %10s\n", "format", "quads/chunk", "KB/chunk", "ns/quad");
+  std::printf("%-8s %12.0f %10.1f %10s\n", "8 byte", quads, fullKB, "-");
+  std::printf("%-8s %12.0f %10.1f %10.2f\n", "4 byte", compactQuads, compactKB, ns / (quads * SAMPLES));
+  std::printf("%.1f%% more quads from splits, %.1f block types per palette\n", 100.0 * (compactQuads / quads - 1.0),
+      paletteTypes);
+
+  int columns = 0;
+  for (int x = -RENDER_DISTANCE; x <= RENDER_DISTANCE; x++)
+    for (int z = -RENDER_DISTANCE; z <= RENDER_DISTANCE; z++)
+      columns += std::sqrt(float(x * x + z * z)) <= RENDER_DISTANCE;
+  std::printf("\nrender distance %d, %d columns: 8 byte %.1f MB, 4 byte %.1f MB, %.0f%% saved\n", RENDER_DISTANCE,
+      columns, columns * fullKB / 1024.0, columns * compactKB / 1024.0, 100.0 * (1.0 - compactKB / fullKB));
+
+  std::printf(valid ? "valid\n" : "NOT valid\n");
+  return valid ? 0 : 1;
+}
@@ -0,0 +1,306 @@
+// Draw commands with a row per chunk against a row per 4x4x4 region (RegionBatches): how many
+// a frame draws, how many quads they cover and what building them costs on the CPU, for a
+// world at render distance 30 seen by a camera turning on the spot. The frustum changes every
+// frame, so every frame is culled from scratch. Also the cost of streaming that world in and
+// editing it through RegionBatches, and how much of its quads the GPU copies around for it.
+//
+//   xmake run bench_region_batches
+//
+// The regions are built through a mock renderer that keeps the quad buffer in memory. After
+// every flush the region faces it touched are checked against the quads their chunks were
+// given last, in slot order, with their slot bits and the region in baseInstance, and
+// contains() against whether their chunks have quads, before and after the flush; any
+// difference is reported and the process exits with 1, so this doubles as RegionBatches'
+// test. The world is centred on chunk 0, half its chunks have negative coordinates.
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <optional>
+#include <random>
+#include <set>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+import glm;
+import chunk_map;
+import buffer_allocator;
+import draw_command;
+import draw_table;
+import frustum_cull;
+import region_batches;
+
+namespace {
+
+constexpr float CHUNK = 62.0f;
+constexpr int RENDER_DISTANCE = 30;
+constexpr int LAYERS = 4;             // chunk layers with quads, surface terrain from y = -2
+constexpr int CENTER = 0;             // of the world in chunks, and the render origin
+constexpr int MAX_FACE_QUADS = 64;    // per chunk face, the mock's are small
+constexpr int CHUNKS_PER_FRAME = 16;  // streamed in, nearest first
+constexpr int EDIT_FRAMES = 2000;
+constexpr int VIEWS = 256;
+constexpr std::uint32_t CAPACITY = 16u << 20; // quads in the mock buffer
+const glm::ivec3 ORIGIN(CENTER);
+
+// The quad buffer in memory, slots from the same allocator ChunkRenderer uses
+struct MockRenderer {
+  BufferAllocator allocator{ CAPACITY };
+  std::unordered_map<std::uint32_t, std::uint32_t> handles; // start quad -> allocator handle
+  std::vector<std::uint64_t> quads = std::vector<std::uint64_t>(CAPACITY);
+  bool overlapped = false;
+
+  DrawArraysIndirectCommand getDrawCommand(int quadCount, std::uint32_t baseInstance) {
+    const std::optional<BufferAllocation> allocation = allocator.allocate(quadCount);
+    if (!allocation)
+      return { 0, 0, 0, baseInstance };
+    handles.emplace(allocation->offset, allocation->handle);
+    return { std::uint32_t(quadCount) * 6, 1, allocation->offset * 6, baseInstance };
+  }
+  void removeDrawCommand(const DrawArraysIndirectCommand& command) {
+    if (command.count == 0)
+      return;
+    const auto it = handles.find(command.first / 6);
+    allocator.free(it->second);
+    handles.erase(it);
+  }
+  void bufferQuads(std::uint32_t startQuad, std::uint32_t quadCount, const void* data) {
+    if (quadCount > 0)
+      std::memcpy(quads.data() + startQuad, data, quadCount * sizeof(std::uint64_t));
+  }
+  void copyQuads(std::uint32_t from, std::uint32_t to, std::uint32_t quadCount) {
+    overlapped |= from < to + quadCount && to < from + quadCount;
+    std::copy_n(quads.begin() + from, quadCount, quads.begin() + to);
+  }
+};
+
+using ChunkQuads = std::array<std::vector<std::uint64_t>, 6>;
+
+struct Region {
+  glm::ivec3 pos;
+  bool operator<(const Region& other) const {
+    return std::tie(pos.x, pos.y, pos.z) < std::tie(other.pos.x, other.pos.y, other.pos.z);
+  }
+};
+
+// What the region's faces have to hold, from the chunks' quads
+bool check_region(const glm::ivec3& region, const std::unordered_map<glm::ivec3, ChunkQuads, ivec3_hash>& chunks,
+    DrawTable& table, const MockRenderer& renderer) {
+  std::vector<std::uint64_t> expected[6];
+  for (int slot = 0; slot < REGION_CHUNKS; slot++) {
+    const glm::ivec3 chunk = region * REGION_SIZE +
+      glm::ivec3(slot & (REGION_SIZE - 1), slot >> REGION_BITS & (REGION_SIZE - 1), slot >> (2 * REGION_BITS));
+    const auto it = chunks.find(chunk);
+    if (it == chunks.end())
+      continue;
+    for (int face = 0; face < 6; face++)
+      for (const std::uint64_t quad : it->second[face])
+        expected[face].push_back(quad | std::uint64_t(slot) << REGION_SLOT_SHIFT);
+  }
+
+  const bool empty = std::all_of(std::begin(expected), std::end(expected), [](const auto& q) { return q.empty(); });
+  if (!table.contains(region))
+    return empty;
+  const std::size_t row = table.row(region);
+  for (int face = 0; face < 6; face++) {
+    const DrawArraysIndirectCommand& command = std::as_const(table).command(row, face);
+    if (command.count / 6 != expected[face].size())
+      return false;
+    if (!std::equal(expected[face].begin(), expected[face].end(), renderer.quads.begin() + command.first / 6))
+      return false;
+    if (command.count > 0 && (command.baseInstance >> 24 != std::uint32_t(face) ||
+        unpack_base_instance(command.baseInstance, ORIGIN) != region * REGION_SIZE))
+      return false;
+  }
+  return !empty;
+}
+
+// A 90 degree frustum at eye looking along yaw / pitch, RENDER_DISTANCE chunks deep
+CullPlanes make_frustum(const float (&eye)[3], float yaw, float pitch) {
+  const float forward[3] = { std::cos(pitch) * std::cos(yaw), std::sin(pitch), std::cos(pitch) * std::sin(yaw) };
+  const float right[3] = { -std::sin(yaw), 0.0f, std::cos(yaw) };
+  const float up[3] = { right[1] * forward[2] - right[2] * forward[1], right[2] * forward[0] - right[0] * forward[2],
+    right[0] * forward[1] - right[1] * forward[0] };
+
+  const auto plane = [&eye](const float (&a)[3], const float (&b)[3], float sign, float offset) {
+    float n[3];
+    for (int i = 0; i < 3; i++)
+      n[i] = a[i] + sign * b[i];
+    const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    for (int i = 0; i < 3; i++)
+      n[i] /= length;
+    return CullPlane{ { n[0], n[1], n[2] }, offset - (n[0] * eye[0] + n[1] * eye[1] + n[2] * eye[2]) };
+  };
+  const float zero[3] = {};
+  return {
+    plane(forward, right, 1.0f, 0.0f),
+    plane(forward, right, -1.0f, 0.0f),
+    plane(forward, up, 1.0f, 0.0f),
+    plane(forward, up, -1.0f, 0.0f),
+    plane(forward, zero, 0.0f, -0.1f),
+    plane(zero, forward, -1.0f, RENDER_DISTANCE * CHUNK),
+  };
+}
+
+double elapsed_ns(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+int main() {
+  std::mt19937_64 rng(7);
+  const auto random_face = [&rng] {
+    std::vector<std::uint64_t> quads(rng() % 4 == 0 ? 0 : 1 + rng() % MAX_FACE_QUADS);
+    for (std::uint64_t& quad : quads)
+      quad = rng() & ((std::uint64_t(1) << REGION_SLOT_SHIFT) - 1);
+    return quads;
+  };
+
+  std::vector<glm::ivec3> world;
+  for (int x = -RENDER_DISTANCE; x <= RENDER_DISTANCE; x++)
+    for (int z = -RENDER_DISTANCE; z <= RENDER_DISTANCE; z++)
+      if (x * x + z * z <= RENDER_DISTANCE * RENDER_DISTANCE)
+        for (int y = -LAYERS / 2; y < LAYERS / 2; y++)
+          world.push_back({ CENTER + x, y, CENTER + z });
+  std::stable_sort(world.begin(), world.end(), [](const glm::ivec3& a, const glm::ivec3& b) {
+    const auto distance = [](const glm::ivec3& c) { return (c.x - CENTER) * (c.x - CENTER) + (c.z - CENTER) * (c.z - CENTER); };
+    return distance(a) < distance(b);
+  });
+
+  std::unordered_map<glm::ivec3, ChunkQuads, ivec3_hash> chunks;
+  DrawTable regionTable{ CHUNK * REGION_SIZE };
+  RegionBatches batches;
+  MockRenderer renderer;
+  bool valid = true;
+
+  std::set<Region> touched;
+  std::vector<glm::ivec3> touchedChunks;
+  const auto upload = [&](const glm::ivec3& chunk, int face, std::vector<std::uint64_t> quads) {
+    batches.update(chunk, face, quads.data(), int(quads.size()));
+    chunks[chunk][face] = std::move(quads);
+    touched.insert({ region_of(chunk) });
+    touchedChunks.push_back(chunk);
+  };
+  // contains() against the chunks' quads, with the updates queued and once they're flushed
+  const auto check_contains = [&](const char* phase, int frame) {
+    for (const glm::ivec3& chunk : touchedChunks) {
+      const auto it = chunks.find(chunk);
+      const bool hasQuads = it != chunks.end() &&
+        std::any_of(it->second.begin(), it->second.end(), [](const auto& quads) { return !quads.empty(); });
+      if (batches.contains(chunk) != hasQuads) {
+        std::printf("%s frame %d: contains() is wrong for chunk (%d, %d, %d)\n", phase, frame, chunk.x, chunk.y, chunk.z);
+        valid = false;
+        return;
+      }
+    }
+  };
+  double flushNs = 0.0;
+  std::size_t uploaded = 0, copied = 0, faceUpdates = 0;
+  const auto flush = [&](const char* phase, int frame) {
+    check_contains(phase, frame);
+    const auto start = std::chrono::steady_clock::now();
+    batches.flush(regionTable, renderer, ORIGIN);
+    flushNs += elapsed_ns(start);
+    uploaded += batches.get_stats().uploadedQuads;
+    copied += batches.get_stats().copiedQuads;
+    for (const Region& region : touched) {
+      if (!check_region(region.pos, chunks, regionTable, renderer) || renderer.overlapped) {
+        std::printf("%s frame %d: region (%d, %d, %d) doesn't hold its chunks' quads\n", phase, frame, region.pos.x,
+            region.pos.y, region.pos.z);
+        valid = false;
+        break;
+      }
+    }
+    check_contains(phase, frame);
+    touched.clear();
+    touchedChunks.clear();
+  };
+
+  // Streamed in nearest first, so most regions are rebuilt a few times as their chunks come in
+  int frames = 0;
+  for (std::size_t i = 0; i < world.size() && valid; frames++) {
+    for (int n = 0; n < CHUNKS_PER_FRAME && i < world.size(); n++, i++)
+      for (int face = 0; face < 6; face++, faceUpdates++)
+        upload(world[i], face, random_face());
+    flush("streaming", frames);
+  }
+  std::printf("world: %zu chunks in %zu regions, %d frames of %d chunks\n", world.size(), batches.get_stats().regions,
+      frames, CHUNKS_PER_FRAME);
+  std::printf("streaming: flush %.1f us/frame, %.0f ns per chunk face, %.1f MB uploaded, %.1f MB copied on the GPU (%.2fx)\n",
+      flushNs / frames / 1000.0, flushNs / faceUpdates, uploaded * 8.0 / (1 << 20), copied * 8.0 / (1 << 20),
+      double(copied) / uploaded);
+
+  // A few chunk faces remeshed a frame, a third of them to as many quads as before, and the odd
+  // chunk unloaded and loaded again
+  flushNs = 0.0;
+  uploaded = copied = faceUpdates = 0;
+  for (int frame = 0; frame < EDIT_FRAMES && valid; frame++) {
+    for (int n = 0; n < 4; n++, faceUpdates++) {
+      const glm::ivec3 chunk = world[rng() % world.size()];
+      const int face = int(rng() % 6);
+      std::vector<std::uint64_t> quads = random_face();
+      if (rng() % 3 == 0) {
+        quads = chunks[chunk][face];
+        for (std::uint64_t& quad : quads)
+          quad ^= 1;
+      }
+      upload(chunk, face, std::move(quads));
+    }
+    if (frame % 8 == 0) {
+      const glm::ivec3 chunk = world[rng() % world.size()];
+      batches.remove(chunk);
+      chunks.erase(chunk);
+      touched.insert({ region_of(chunk) });
+      touchedChunks.push_back(chunk);
+      if (frame % 16 == 0)
+        for (int face = 0; face < 6; face++, faceUpdates++)
+          upload(chunk, face, random_face());
+    }
+    flush("edits", frame);
+  }
+  std::printf("edits: flush %.1f us/frame, %.0f ns per chunk face, %.1f KB uploaded, %.1f KB copied on the GPU (%.1fx)\n",
+      flushNs / EDIT_FRAMES / 1000.0, flushNs / faceUpdates, uploaded * 8.0 / 1024, copied * 8.0 / 1024,
+      uploaded ? double(copied) / uploaded : 0.0);
+
+  // The same chunks with a row each, like ChunkManager has without REGION_BATCHES
+  DrawTable chunkTable{ CHUNK };
+  for (const auto& [chunk, quads] : chunks) {
+    const std::size_t row = chunkTable.row(chunk);
+    for (int face = 0; face < 6; face++)
+      chunkTable.command(row, face) = { std::uint32_t(quads[face].size()) * 6, 1, 0, 0 };
+  }
+
+  const float eye[3] = { (CENTER + 0.5f) * CHUNK, 0.5f * CHUNK, (CENTER + 0.5f) * CHUNK };
+  const glm::ivec3 cameraChunk(CENTER, 0, CENTER);
+  std::vector<CullPlanes> views;
+  for (int view = 0; view < VIEWS; view++)
+    views.push_back(make_frustum(eye, view * 6.2831853f / VIEWS, std::sin(view * 0.7f) * 0.3f));
+
+  std::vector<DrawArraysIndirectCommand> out(100000);
+  std::printf("\n%-8s %8s %16s %14s %14s\n", "table", "rows", "commands/frame", "quads/frame", "build us/frame");
+  const auto run = [&](const char* name, DrawTable& table, const glm::ivec3& camera) {
+    std::size_t commands = 0, quads = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (const CullPlanes& view : views)
+      commands += table.cull(camera, view, out.data(), out.size());
+    const double ns = elapsed_ns(start);
+    for (const CullPlanes& view : views) {
+      const std::size_t count = table.cull(camera, view, out.data(), out.size());
+      for (std::size_t i = 0; i < count; i++)
+        quads += out[i].count / 6;
+    }
+    std::printf("%-8s %8zu %16.0f %14.0f %14.1f\n", name, table.size(), double(commands) / VIEWS, double(quads) / VIEWS,
+        ns / VIEWS / 1000.0);
+  };
+  run("chunk", chunkTable, cameraChunk);
+  run("region", regionTable, region_of(cameraChunk));
+
+  std::printf(valid ? "valid\n" : "NOT valid\n");
+  return valid ? 0 : 1;
+}
@@ -0,0 +1,206 @@
+module;
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+export module block_storage;
+
+export {
+  // Palette + bit-packed block storage for one chunk.
+  //
+  // Each voxel stores an index into a small per-chunk palette using 1, 2 or 4 bits.
+  // Chunks with more than 16 distinct types store the raw type in 8 bits, and a chunk
+  // made of a single type (all air, all stone...) stores nothing but that type.
+  // 64 is a multiple of every width, so an index never straddles two words.
+  template <std::uint32_t VOLUME>
+  class PaletteStorage {
+  public:
+    static_assert(std::endian::native == std::endian::little, "8-bit mode stores raw bytes in little-endian words");
+
+    PaletteStorage() noexcept = default;
+    explicit PaletteStorage(std::uint8_t uniform_type) noexcept { palette[0] = uniform_type; }
+
+    PaletteStorage(const PaletteStorage&) = delete;
+    PaletteStorage& operator=(const PaletteStorage&) = delete;
+    PaletteStorage(PaletteStorage&&) noexcept = default;
+    PaletteStorage& operator=(PaletteStorage&&) noexcept = default;
+
+    inline std::uint8_t get(std::uint32_t index) const noexcept {
+      if (bits == 0)
+        return palette[0];
+      const std::uint32_t per_word_log = 6 - bits_log;
+      const std::uint64_t word = words[index >> per_word_log];
+      const std::uint32_t value = (word >> ((index & ((1u << per_word_log) - 1)) << bits_log)) & ((1u << bits) - 1);
+      return bits == 8 ? static_cast<std::uint8_t>(value) : palette[value];
+    }
+
+    void set(std::uint32_t index, std::uint8_t type) {
+      if (bits == 0 && palette[0] == type)
+        return;
+
+      int slot = bits == 8 ? type : find_in_palette(type);
+      if (slot < 0) {
+        if (palette_size == (1u << bits))
+          resize(bits == 0 ? 1 : (bits == 4 ? 8 : bits * 2));
+        if (bits == 8) {
+          slot = type;
+        } else {
+          slot = palette_size;
+          palette[palette_size++] = type;
+        }
+      }
+      write_index(index, static_cast<std::uint32_t>(slot));
+    }
+
+    // Drops to zero storage and a single palette entry
+    void fill(std::uint8_t type) noexcept {
+      words.reset();
+      bits = 0;
+      bits_log = 0;
+      palette_size = 1;
+      palette[0] = type;
+    }
+
+    // Rebuilds the palette from the types that are actually used and repacks at the
+    // narrowest width that fits. set() only ever widens, so call this once a batch of
+    // edits is done (e.g. after generation).
+    void compact() {
+      std::array<std::uint32_t, 256> counts{};
+      for_each([&](std::uint32_t, std::uint8_t type) { ++counts[type]; });
+
+      std::uint32_t used = 0;
+      std::uint8_t types[256];
+      for (std::uint32_t t = 0; t < 256; t++)
+        if (counts[t])
+          types[used++] = static_cast<std::uint8_t>(t);
+
+      if (used == 1) {
+        fill(types[0]);
+        return;
+      }
+      const std::uint8_t target = used <= 2 ? 1 : used <= 4 ? 2 : used <= 16 ? 4 : 8;
+      if (target == bits && (bits == 8 || used == palette_size))
+        return;
+
+      std::unique_ptr<std::uint8_t[]> flat(new std::uint8_t[VOLUME]);
+      unpack(flat.get());
+
+      bits = 0;
+      palette_size = static_cast<std::uint16_t>(target == 8 ? 0 : used);
+      std::copy_n(types, palette_size, palette.begin());
+      allocate(target);
+
+      std::array<std::uint8_t, 256> remap{};
+      for (std::uint32_t i = 0; i < palette_size; i++)
+        remap[palette[i]] = static_cast<std::uint8_t>(i);
+      for (std::uint32_t i = 0; i < VOLUME; i++)
+        write_index(i, bits == 8 ? flat[i] : remap[flat[i]]);
+    }
+
+    // Full scan in index order, decoding one word at a time; fn(index, type)
+    template <typename Fn>
+    void for_each(Fn&& fn) const {
+      switch (bits) {
+      case 0:
+        for (std::uint32_t i = 0; i < VOLUME; i++)
+          fn(i, palette[0]);
+        break;
+      case 1: for_each_packed<1>(fn); break;
+      case 2: for_each_packed<2>(fn); break;
+      case 4: for_each_packed<4>(fn); break;
+      case 8: for_each_packed<8>(fn); break;
+      }
+    }
+
+    // Decodes the whole chunk into a flat array of VOLUME bytes
+    void unpack(std::uint8_t* out) const {
+      if (bits == 0) {
+        std::memset(out, palette[0], VOLUME);
+        return;
+      }
+      for_each([out](std::uint32_t i, std::uint8_t type) { out[i] = type; });
+    }
+
+    bool is_uniform() const noexcept { return bits == 0; }
+    std::uint8_t uniform_type() const noexcept { return palette[0]; }
+    std::uint8_t bits_per_voxel() const noexcept { return bits; }
+    std::uint32_t palette_entries() const noexcept { return bits == 8 ? 256 : palette_size; }
+
+    // Bytes held on the heap for the packed indices
+    std::size_t heap_bytes() const noexcept { return bits == 0 ? 0 : word_count(bits) * sizeof(std::uint64_t); }
+
+  private:
+    static constexpr std::uint32_t word_count(std::uint8_t b) noexcept { return (VOLUME * b + 63) / 64; }
+
+    // Width is a template argument so the inner loop fully unrolls
+    template <std::uint8_t BITS, typename Fn>
+    void for_each_packed(Fn& fn) const {
+      constexpr std::uint32_t per_word = 64 / BITS;
+      constexpr std::uint64_t mask = (1ull << BITS) - 1;
+      constexpr std::uint32_t full_words = VOLUME / per_word;
+      for (std::uint32_t w = 0; w < full_words; w++) {
+        const std::uint64_t word = words[w];
+        for (std::uint32_t j = 0; j < per_word; j++) {
+          const std::uint32_t value = static_cast<std::uint32_t>((word >> (j * BITS)) & mask);
+          fn(w * per_word + j, BITS == 8 ? static_cast<std::uint8_t>(value) : palette[value]);
+        }
+      }
+      // VOLUME need not be a multiple of 64 (62^3 isn't), the last word may be partial
+      for (std::uint32_t i = full_words * per_word; i < VOLUME; i++) {
+        const std::uint32_t value = static_cast<std::uint32_t>((words[full_words] >> ((i - full_words * per_word) * BITS)) & mask);
+        fn(i, BITS == 8 ? static_cast<std::uint8_t>(value) : palette[value]);
+      }
+    }
+
+    int find_in_palette(std::uint8_t type) const noexcept {
+      for (std::uint32_t i = 0; i < palette_size; i++)
+        if (palette[i] == type)
+          return static_cast<int>(i);
+      return -1;
+    }
+
+    void allocate(std::uint8_t new_bits) {
+      bits = new_bits;
+      bits_log = static_cast<std::uint8_t>(std::countr_zero(static_cast<unsigned>(new_bits)));
+      words.reset(new std::uint64_t[word_count(new_bits)]{});
+    }
+
+    inline void write_index(std::uint32_t index, std::uint32_t value) noexcept {
+      const std::uint32_t per_word_log = 6 - bits_log;
+      const std::uint32_t shift = (index & ((1u << per_word_log) - 1)) << bits_log;
+      std::uint64_t& word = words[index >> per_word_log];
+      word = (word & ~(((1ull << bits) - 1) << shift)) | (static_cast<std::uint64_t>(value) << shift);
+    }
+
+    // Repacks every voxel at new_bits; going to 8 bits swaps palette indices for raw types
+    void resize(std::uint8_t new_bits) {
+      std::unique_ptr<std::uint8_t[]> flat(new std::uint8_t[VOLUME]);
+      unpack(flat.get());
+
+      const bool was_uniform = bits == 0;
+      allocate(new_bits);
+
+      if (new_bits == 8) {
+        std::memcpy(words.get(), flat.get(), VOLUME); // little-endian: byte i is bits [8i, 8i + 8)
+        palette_size = 0;
+        return;
+      }
+      if (was_uniform)
+        return; // every index is already 0 == palette[0]
+
+      std::array<std::uint8_t, 256> remap{};
+      for (std::uint32_t i = 0; i < palette_size; i++)
+        remap[palette[i]] = static_cast<std::uint8_t>(i);
+      for (std::uint32_t i = 0; i < VOLUME; i++)
+        write_index(i, remap[flat[i]]);
+    }
+
+    std::unique_ptr<std::uint64_t[]> words;
+    std::array<std::uint8_t, 16> palette{};
+    std::uint16_t palette_size = 1;
+    std::uint8_t bits = 0;
+    std::uint8_t bits_log = 0;
+  };
+}
@@ -0,0 +1,362 @@
+module;
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <optional>
+#include <vector>
+export module buffer_allocator;
+
+export {
+  struct BufferAllocatorStats {
+    std::uint32_t capacity = 0;     // units
+    std::uint32_t used = 0;         // units handed out
+    std::uint32_t allocations = 0;  // live ones
+    std::uint32_t freeBlocks = 0;
+    std::uint32_t largestFree = 0;  // units, the biggest request that can always succeed is a bit less, see allocate()
+
+    // 0 while all free space is one block, towards 1 the more it's split up
+    float fragmentation() const noexcept {
+      const std::uint32_t free = capacity - used;
+      return free == 0 ? 0.0f : 1.0f - static_cast<float>(largestFree) / static_cast<float>(free);
+    }
+  };
+
+  struct BufferAllocation {
+    std::uint32_t offset = 0; // units from the start of the buffer
+    std::uint32_t handle = 0; // for free()
+  };
+
+  // An allocation move_last() moved; the old handle is gone, the contents still have to be copied
+  struct BufferMove {
+    std::uint32_t from = 0;
+    std::uint32_t to = 0;
+    std::uint32_t size = 0;
+    std::uint32_t handle = 0;
+  };
+
+  // Two-level segregated fit (TLSF) allocator over a range of `capacity` abstract units, e.g.
+  // quads of a GPU buffer. It never touches the memory it manages: block headers live in a
+  // node pool on the CPU side, so it works the same for mapped GL buffers and in tests.
+  //
+  // Free blocks sit in one of FL_COUNT x SL_COUNT lists by size: the first level is the power of
+  // two, the second splits that into SL_COUNT linear steps. Two bitmaps say which lists are
+  // non-empty, so allocate() and free() are a handful of bit scans and list operations,
+  // independent of how many blocks there are. Neighbouring free blocks are merged on free().
+  class BufferAllocator {
+  public:
+    explicit BufferAllocator(std::uint32_t capacity) : capacity(capacity) {
+      for (auto& level : heads)
+        for (std::uint32_t& head : level)
+          head = NONE;
+      blocks.push_back(Block{ 0, capacity });
+      if (capacity > 0)
+        insert_free(0);
+    }
+
+    // `size` units from a free block at least size rounded up to its list's step (size / 32 at
+    // most), so the first block of the list found fits without searching it. Fails only when
+    // no free block that big is left
+    std::optional<BufferAllocation> allocate(std::uint32_t size) {
+      if (size == 0 || size > capacity)
+        return std::nullopt;
+
+      int fl, sl;
+      mapping(round_up(size), fl, sl);
+      const std::uint32_t index = find_free(fl, sl);
+      if (index == NONE)
+        return std::nullopt;
+      remove_free(index);
+
+      // The rest of the block goes back as a new free block
+      if (blocks[index].size > size) {
+        const std::uint32_t rest = new_block();
+        Block& block = blocks[index];
+        blocks[rest].offset = block.offset + size;
+        blocks[rest].size = block.size - size;
+        blocks[rest].prevPhys = index;
+        blocks[rest].nextPhys = block.nextPhys;
+        if (block.nextPhys != NONE)
+          blocks[block.nextPhys].prevPhys = rest;
+        block.nextPhys = rest;
+        block.size = size;
+        if (lastBlock == index)
+          lastBlock = rest;
+        insert_free(rest);
+      }
+
+      blocks[index].used = true;
+      used += size;
+      allocations++;
+      return BufferAllocation{ blocks[index].offset, index };
+    }
+
+    void free(std::uint32_t handle) {
+      std::uint32_t index = handle;
+      blocks[index].used = false;
+      used -= blocks[index].size;
+      allocations--;
+
+      const std::uint32_t next = blocks[index].nextPhys;
+      if (next != NONE && !blocks[next].used) {
+        remove_free(next);
+        absorb_next(index);
+      }
+      const std::uint32_t prev = blocks[index].prevPhys;
+      if (prev != NONE && !blocks[prev].used) {
+        remove_free(prev);
+        absorb_next(prev);
+        index = prev;
+      }
+      insert_free(index);
+    }
+
+    // Offset past the last allocation, 0 with none: what the memory behind can shrink to
+    std::uint32_t end() const noexcept {
+      return blocks[lastBlock].used ? capacity : blocks[lastBlock].offset;
+    }
+
+    // Changes the capacity, growing the free space at the end or cutting it off. Shrinking
+    // below end() fails
+    bool resize(std::uint32_t newCapacity) {
+      if (newCapacity == 0 || newCapacity < end())
+        return false;
+      if (newCapacity == capacity)
+        return true;
+
+      if (!blocks[lastBlock].used) {
+        // The free block at the end takes the whole difference
+        remove_free(lastBlock);
+        if (blocks[lastBlock].offset == newCapacity) {
+          const std::uint32_t prev = blocks[lastBlock].prevPhys;
+          absorb_next(prev);
+          blocks[prev].size -= capacity - newCapacity;
+          lastBlock = prev;
+        } else {
+          blocks[lastBlock].size = newCapacity - blocks[lastBlock].offset;
+          insert_free(lastBlock);
+        }
+      } else {
+        const std::uint32_t rest = new_block();
+        blocks[rest].offset = capacity;
+        blocks[rest].size = newCapacity - capacity;
+        blocks[rest].prevPhys = lastBlock;
+        blocks[lastBlock].nextPhys = rest;
+        lastBlock = rest;
+        insert_free(rest);
+      }
+      capacity = newCapacity;
+      return true;
+    }
+
+    // Compaction step: moves the allocation nearest the end into a free block before it, if one
+    // fits. Repeated, it fills holes from the back and grows the free space at the end, which
+    // resize() can then cut off.
+    std::optional<BufferMove> move_last() {
+      const bool freeTail = !blocks[lastBlock].used;
+      const std::uint32_t index = freeTail ? blocks[lastBlock].prevPhys : lastBlock;
+      if (index == NONE)
+        return std::nullopt;
+
+      // Everything else that's free lies before it, once the free space after it is out of the lists
+      const std::uint32_t tail = lastBlock;
+      if (freeTail)
+        remove_free(tail);
+      const std::optional<BufferAllocation> moved = allocate(blocks[index].size);
+      if (freeTail)
+        insert_free(tail);
+      if (!moved)
+        return std::nullopt;
+
+      const BufferMove move{ blocks[index].offset, moved->offset, blocks[index].size, moved->handle };
+      free(index);
+      return move;
+    }
+
+    // Units behind an allocation, what it was asked for
+    std::uint32_t size_of(std::uint32_t handle) const noexcept { return blocks[handle].size; }
+
+    // O(1) but for largestFree, which looks at the highest non-empty list
+    BufferAllocatorStats get_stats() const noexcept {
+      BufferAllocatorStats stats;
+      stats.capacity = capacity;
+      stats.used = used;
+      stats.allocations = allocations;
+      stats.freeBlocks = freeBlocks;
+      if (flBitmap) {
+        const int fl = 31 - std::countl_zero(flBitmap);
+        const int sl = 31 - std::countl_zero(slBitmap[fl]);
+        for (std::uint32_t i = heads[fl][sl]; i != NONE; i = blocks[i].nextFree)
+          stats.largestFree = std::max(stats.largestFree, blocks[i].size);
+      }
+      return stats;
+    }
+
+    // Walks every block and list and checks they agree with each other and the counters.
+    // O(n), for tests and benchmarks
+    bool validate() const {
+      std::uint32_t offset = 0, usedUnits = 0, live = 0, freeCount = 0;
+      std::uint32_t prev = NONE;
+      for (std::uint32_t i = 0; i != NONE && capacity > 0; i = blocks[i].nextPhys) {
+        const Block& block = blocks[i];
+        if (block.offset != offset || block.size == 0 || block.prevPhys != prev)
+          return false;
+        if (block.used) {
+          usedUnits += block.size;
+          live++;
+        } else {
+          if (prev != NONE && !blocks[prev].used)
+            return false; // two free neighbours should have been merged
+          int fl, sl;
+          mapping(block.size, fl, sl);
+          if (!in_list(i, fl, sl))
+            return false;
+          freeCount++;
+        }
+        offset += block.size;
+        prev = i;
+      }
+      if (prev != lastBlock)
+        return false;
+      if (offset != capacity || usedUnits != used || live != allocations || freeCount != freeBlocks)
+        return false;
+
+      std::uint32_t listed = 0;
+      for (int fl = 0; fl < FL_COUNT; fl++) {
+        if (((flBitmap >> fl) & 1) != (slBitmap[fl] != 0))
+          return false;
+        for (int sl = 0; sl < SL_COUNT; sl++) {
+          if (((slBitmap[fl] >> sl) & 1) != (heads[fl][sl] != NONE))
+            return false;
+          for (std::uint32_t i = heads[fl][sl]; i != NONE; i = blocks[i].nextFree)
+            listed++;
+        }
+      }
+      return listed == freeBlocks;
+    }
+
+    // Smallest size whose list only holds blocks >= size: what allocate() searches by, so
+    // asking for this much instead of size costs no extra search
+    static std::uint32_t round_up(std::uint32_t size) noexcept {
+      if (size < SL_COUNT)
+        return size;
+      const std::uint32_t step = (1u << (31 - std::countl_zero(size) - SL_LOG2)) - 1;
+      return size > ~0u - step ? size : size + step;
+    }
+
+  private:
+    static constexpr std::uint32_t NONE = ~0u;
+    static constexpr int SL_LOG2 = 5;
+    static constexpr int SL_COUNT = 1 << SL_LOG2;
+    // First level 0 holds the sizes below SL_COUNT one per list, level n >= 1 the
+    // sizes [2^(n + SL_LOG2 - 1), 2^(n + SL_LOG2))
+    static constexpr int FL_COUNT = 32 - SL_LOG2 + 1;
+
+    struct Block {
+      std::uint32_t offset = 0;
+      std::uint32_t size = 0;
+      std::uint32_t prevPhys = NONE;
+      std::uint32_t nextPhys = NONE;
+      std::uint32_t prevFree = NONE;
+      std::uint32_t nextFree = NONE; // also links the unused nodes
+      bool used = false;
+    };
+
+    static void mapping(std::uint32_t size, int& fl, int& sl) noexcept {
+      if (size < SL_COUNT) {
+        fl = 0;
+        sl = static_cast<int>(size);
+        return;
+      }
+      const int log2 = 31 - std::countl_zero(size);
+      fl = log2 - SL_LOG2 + 1;
+      sl = static_cast<int>(size >> (log2 - SL_LOG2)) - SL_COUNT;
+    }
+
+    std::uint32_t find_free(int fl, int sl) const noexcept {
+      std::uint32_t slMap = slBitmap[fl] & (~0u << sl);
+      if (!slMap) {
+        const std::uint32_t flMap = fl + 1 < FL_COUNT ? flBitmap & (~0u << (fl + 1)) : 0;
+        if (!flMap)
+          return NONE;
+        fl = std::countr_zero(flMap);
+        slMap = slBitmap[fl];
+      }
+      return heads[fl][std::countr_zero(slMap)];
+    }
+
+    void insert_free(std::uint32_t index) noexcept {
+      int fl, sl;
+      mapping(blocks[index].size, fl, sl);
+      Block& block = blocks[index];
+      block.prevFree = NONE;
+      block.nextFree = heads[fl][sl];
+      if (block.nextFree != NONE)
+        blocks[block.nextFree].prevFree = index;
+      heads[fl][sl] = index;
+      flBitmap |= 1u << fl;
+      slBitmap[fl] |= 1u << sl;
+      freeBlocks++;
+    }
+
+    void remove_free(std::uint32_t index) noexcept {
+      int fl, sl;
+      mapping(blocks[index].size, fl, sl);
+      const Block& block = blocks[index];
+      if (block.prevFree != NONE)
+        blocks[block.prevFree].nextFree = block.nextFree;
+      else
+        heads[fl][sl] = block.nextFree;
+      if (block.nextFree != NONE)
+        blocks[block.nextFree].prevFree = block.prevFree;
+      if (heads[fl][sl] == NONE) {
+        slBitmap[fl] &= ~(1u << sl);
+        if (!slBitmap[fl])
+          flBitmap &= ~(1u << fl);
+      }
+      freeBlocks--;
+    }
+
+    // Merges the physical successor of `index` (out of its list) into it and recycles its node
+    void absorb_next(std::uint32_t index) noexcept {
+      const std::uint32_t next = blocks[index].nextPhys;
+      blocks[index].size += blocks[next].size;
+      blocks[index].nextPhys = blocks[next].nextPhys;
+      if (blocks[next].nextPhys != NONE)
+        blocks[blocks[next].nextPhys].prevPhys = index;
+      if (lastBlock == next)
+        lastBlock = index;
+      blocks[next] = Block{};
+      blocks[next].nextFree = unusedNodes;
+      unusedNodes = next;
+    }
+
+    std::uint32_t new_block() {
+      if (unusedNodes == NONE) {
+        blocks.emplace_back();
+        return static_cast<std::uint32_t>(blocks.size() - 1);
+      }
+      const std::uint32_t index = unusedNodes;
+      unusedNodes = blocks[index].nextFree;
+      blocks[index] = Block{};
+      return index;
+    }
+
+    bool in_list(std::uint32_t index, int fl, int sl) const noexcept {
+      for (std::uint32_t i = heads[fl][sl]; i != NONE; i = blocks[i].nextFree)
+        if (i == index)
+          return true;
+      return false;
+    }
+
+    std::uint32_t capacity;
+    std::uint32_t used = 0;
+    std::uint32_t allocations = 0;
+    std::uint32_t freeBlocks = 0;
+    std::uint32_t flBitmap = 0;
+    std::uint32_t slBitmap[FL_COUNT] = {};
+    std::uint32_t heads[FL_COUNT][SL_COUNT];
+    std::vector<Block> blocks; // node pool, block 0 always starts at offset 0
+    std::uint32_t lastBlock = 0;
+    std::uint32_t unusedNodes = NONE;
+  };
+}
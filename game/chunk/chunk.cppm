@@ -1,21 +1,20 @@
 module;
 #include <array>
+#include <bit>
 #include <cstdint>
+#include <cstring>
+#include <memory>
+#include <utility>
 export module chunk;
 
 import core;
 import glm;
 import aabb;
 import logger;
-import ssbo;
 import shader;
-
-export struct DrawArraysIndirectCommand {
-  GLuint count;         // vertices to draw
-  GLuint instanceCount; // usually 1
-  GLuint first;         // start index
-  GLuint baseInstance;  // usually 0
-};
+import block_storage;
+import mesher;
+import utility;
 
 export struct Block {
   enum class blocks : std::uint8_t {
@@ -82,8 +81,87 @@ export struct face_gpu {
 };
 static_assert(sizeof(face_gpu) == sizeof(std::uint32_t));
 
+// Face order used by the mesher, the draw commands and main.vs: +y, -y, +x, -x, +z, -z.
+// The opposite of face f is f ^ 1
+export inline constexpr std::array<glm::ivec3, 6> FACE_NORMALS = {
+  glm::ivec3( 0,  1,  0),
+  glm::ivec3( 0, -1,  0),
+  glm::ivec3( 1,  0,  0),
+  glm::ivec3(-1,  0,  0),
+  glm::ivec3( 0,  0,  1),
+  glm::ivec3( 0,  0, -1)
+};
+
+export enum class ChunkStorage : std::uint8_t {
+  Palette, // Compact, for chunks that aren't being meshed
+  Padded   // The mesher's input layout, kept current on every edit
+};
+
+// What the padding on a face without a resident neighbour holds
+export enum class PaddingFallback : std::uint8_t {
+  Air,   // The chunk's boundary faces are drawn
+  Opaque // They are hidden until the neighbour arrives
+};
+
+export enum class ChunkOccupancy : std::uint8_t {
+  Empty,  // All air: nothing to mesh, draw or hit
+  Opaque, // No air at all: only its boundary can have visible faces
+  Mixed
+};
+
+// Mesher input for one chunk: ZXY voxels with the interior at [1, CS] and a one voxel
+// border mirrored from the 6 face neighbours, plus the matching opaque column masks.
+// Edge and corner padding is never read by the mesher and stays air.
+export struct PaddedBlocks {
+  alignas(64) std::uint8_t voxels[CS_P3]{};
+  alignas(64) std::uint64_t opaque_mask[CS_P2]{};
+};
+
+// Occupancy of the interior, from the opaque masks alone
+export ChunkOccupancy classify_occupancy(const PaddedBlocks& blocks) noexcept {
+  constexpr std::uint64_t INTERIOR = ((1ull << CS) - 1) << 1;
+  int solid = 0;
+  for (int y = 1; y <= CS; y++)
+    for (int x = 1; x <= CS; x++)
+      solid += std::popcount(blocks.opaque_mask[(y * CS_P) + x] & INTERIOR);
+  return solid == 0 ? ChunkOccupancy::Empty : solid == CS * CS * CS ? ChunkOccupancy::Opaque : ChunkOccupancy::Mixed;
+}
+
+// True if the CS x CS square of padded layer `layer` along the axis of `face` is entirely opaque.
+// layer CS / 1 is the chunk's own boundary on a positive / negative face, CS_P - 1 / 0 the padding past it
+export bool is_layer_solid(const PaddedBlocks& blocks, int face, int layer) noexcept {
+  constexpr std::uint64_t INTERIOR = ((1ull << CS) - 1) << 1;
+  const int axis = face < 2 ? 1 : face < 4 ? 0 : 2;
+  if (axis == 2) {
+    // z is the bit index, one bit per mask row
+    for (int y = 1; y <= CS; y++)
+      for (int x = 1; x <= CS; x++)
+        if (!(blocks.opaque_mask[(y * CS_P) + x] >> layer & 1))
+          return false;
+    return true;
+  }
+  // A whole z row per mask
+  for (int i = 1; i <= CS; i++) {
+    const std::uint64_t row = axis == 0 ? blocks.opaque_mask[(i * CS_P) + layer] : blocks.opaque_mask[(layer * CS_P) + i];
+    if ((row & INTERIOR) != INTERIOR)
+      return false;
+  }
+  return true;
+}
+
+// Bit f set: the chunk's own boundary layer on face f (FACE_NORMALS order) is entirely opaque
+export std::uint8_t solid_boundary_faces(const PaddedBlocks& blocks) noexcept {
+  std::uint8_t faces = 0;
+  for (int face = 0; face < 6; face++)
+    if (is_layer_solid(blocks, face, (face & 1) ? 1 : CS))
+      faces |= 1 << face;
+  return faces;
+}
+
 export class Chunk {
 public:
+  static_assert(CHUNK_SIZE.x == CS && CHUNK_SIZE.y == CS && CHUNK_SIZE.z == CS, "Chunks must match the mesher's chunk size");
+
   explicit Chunk(const glm::ivec3& pos)
 	  : position(pos),
 	  changed(true),           // Force initial upload
@@ -94,31 +172,168 @@ public:
 	{
 		glm::vec3 world = chunk_to_world(position);
 		aabb = AABB(world, world + glm::vec3(CHUNK_SIZE));
-
-		// block_ssbo = ssbo::PersistentWrite(sizeof(block_types));
 	}
   ~Chunk() = default;
 
   Block::blocks get_block_type(const int& x, const int& y, const int& z) const noexcept {
-	  return static_cast<Block::blocks>(block_types[x + (y << LOG_SIZE.x) + (z << (LOG_SIZE.x + LOG_SIZE.y))]);
+	  if (padded)
+		  return static_cast<Block::blocks>(padded->voxels[get_zxy_index(x + 1, y + 1, z + 1)]);
+	  return static_cast<Block::blocks>(block_types.get(get_index(x, y, z)));
   }
   void set_block_type(int x, int y, int z, Block::blocks type) noexcept {
-	  int index = get_index(x, y, z);
-	  if (block_types[index] != static_cast<std::uint8_t>(type)) {
-		  if (block_types[index] == static_cast<std::uint8_t>(Block::blocks::AIR) &&
+	  const std::uint8_t old_type = static_cast<std::uint8_t>(get_block_type(x, y, z));
+	  if (old_type != static_cast<std::uint8_t>(type)) {
+		  if (old_type == static_cast<std::uint8_t>(Block::blocks::AIR) &&
 				  type != Block::blocks::AIR)
 			  ++non_air_count;
-		  else if (block_types[index] != static_cast<std::uint8_t>(Block::blocks::AIR) &&
+		  else if (old_type != static_cast<std::uint8_t>(Block::blocks::AIR) &&
 				  type == Block::blocks::AIR)
 			  --non_air_count;
 
-		  block_types[index] = static_cast<std::uint8_t>(type);
+		  if (y == CS - 1) ++border_generation[0];
+		  if (y == 0)      ++border_generation[1];
+		  if (x == CS - 1) ++border_generation[2];
+		  if (x == 0)      ++border_generation[3];
+		  if (z == CS - 1) ++border_generation[4];
+		  if (z == 0)      ++border_generation[5];
+
+		  // Only ever cleared here: a boundary that fills up again stays "not solid" until the next generation
+		  if (type == Block::blocks::AIR) {
+			  if (y == CS - 1) solid_faces &= ~(1u << 0);
+			  if (y == 0)      solid_faces &= ~(1u << 1);
+			  if (x == CS - 1) solid_faces &= ~(1u << 2);
+			  if (x == 0)      solid_faces &= ~(1u << 3);
+			  if (z == CS - 1) solid_faces &= ~(1u << 4);
+			  if (z == 0)      solid_faces &= ~(1u << 5);
+		  }
+
+		  if (padded) {
+			  write_padded(x + 1, y + 1, z + 1, type);
+			  // Border voxels are also part of the neighbour's padding
+			  if (y == CS - 1) mirror_to_neighbour(0, x + 1, 0, z + 1, type);
+			  if (y == 0)      mirror_to_neighbour(1, x + 1, CS_P - 1, z + 1, type);
+			  if (x == CS - 1) mirror_to_neighbour(2, 0, y + 1, z + 1, type);
+			  if (x == 0)      mirror_to_neighbour(3, CS_P - 1, y + 1, z + 1, type);
+			  if (z == CS - 1) mirror_to_neighbour(4, x + 1, y + 1, 0, type);
+			  if (z == 0)      mirror_to_neighbour(5, x + 1, y + 1, CS_P - 1, type);
+		  } else {
+			  block_types.set(get_index(x, y, z), static_cast<std::uint8_t>(type));
+		  }
 		  changed = true;
+		  edited = true;
 	  }
   }
 
+  // Sets every block in the chunk, dropping back to the zero-storage uniform mode
+  void fill(Block::blocks type) noexcept {
+	  set_storage(ChunkStorage::Palette);
+	  block_types.fill(static_cast<std::uint8_t>(type));
+	  non_air_count = type == Block::blocks::AIR ? 0 : SIZE;
+	  solid_faces = type == Block::blocks::AIR ? 0 : 0x3f;
+	  for (std::uint32_t& generation : border_generation)
+		  ++generation;
+	  changed = true;
+	  edited = true;
+  }
+
+  // Takes over blocks that were generated off-thread, leaving the chunk in Palette storage
+  void assign_blocks(PaletteStorage<SIZE>&& blocks, int non_air, std::uint8_t solid_boundaries) noexcept {
+	  padded.reset();
+	  block_types = std::move(blocks);
+	  non_air_count = non_air;
+	  solid_faces = solid_boundaries;
+	  changed = true;
+  }
+
+  ChunkOccupancy occupancy() const noexcept {
+	  return non_air_count == 0 ? ChunkOccupancy::Empty : non_air_count == SIZE ? ChunkOccupancy::Opaque : ChunkOccupancy::Mixed;
+  }
+
+  // Repacks the block storage at the narrowest palette width; call after bulk edits
+  void compact_storage() { if (!padded) block_types.compact(); }
+
+  ChunkStorage storage() const noexcept { return padded ? ChunkStorage::Padded : ChunkStorage::Palette; }
+
+  // Switching to Padded also pulls the border from the current neighbours
+  void set_storage(ChunkStorage mode, PaddingFallback fallback = PaddingFallback::Air) {
+	  if (mode == storage())
+		  return;
+
+	  if (mode == ChunkStorage::Padded) {
+		  padded = std::make_unique<PaddedBlocks>();
+		  int x = 0, y = 0, z = 0;
+		  block_types.for_each([&](std::uint32_t, std::uint8_t type) {
+			  padded->voxels[get_zxy_index(x + 1, y + 1, z + 1)] = type;
+			  if (++x == CS) { x = 0; if (++y == CS) { y = 0; ++z; } }
+		  });
+		  buildOpaqueMask(padded->voxels, padded->opaque_mask);
+		  block_types.fill(static_cast<std::uint8_t>(Block::blocks::AIR));
+		  for (int face = 0; face < 6; face++)
+			  refresh_padding(face, fallback);
+	  } else {
+		  std::unique_ptr<PaddedBlocks> src = std::move(padded);
+		  for (int z = 0; z < CS; z++)
+			  for (int y = 0; y < CS; y++)
+				  for (int x = 0; x < CS; x++)
+					  block_types.set(get_index(x, y, z), src->voxels[get_zxy_index(x + 1, y + 1, z + 1)]);
+		  block_types.compact();
+	  }
+  }
+
+  // Mesher input, only valid in Padded mode: mesh(padded_voxels(), opaque_mask(), meshData)
+  const std::uint8_t* padded_voxels() const noexcept { return padded ? padded->voxels : nullptr; }
+  const std::uint64_t* opaque_mask() const noexcept { return padded ? padded->opaque_mask : nullptr; }
+
+  // Re-assembles the padding slab on one face from neighbours[face]. A neighbour in Padded
+  // storage too is copied row by row (voxel memcpy, masked mask words), a uniform one is a
+  // fill, and anything else is decoded voxel by voxel. Without a neighbour it's `fallback`
+  void refresh_padding(int face, PaddingFallback fallback = PaddingFallback::Air) noexcept {
+	  if (!padded)
+		  return;
+	  const Chunk* n = neighbours[face];
+	  const int axis = face < 2 ? 1 : face < 4 ? 0 : 2;
+	  const bool positive = (face & 1) == 0;
+	  const int pad = positive ? CS_P - 1 : 0;      // where the slab goes in our padding
+	  const int src = positive ? 0 : CS - 1;        // which layer of the neighbour it mirrors
+
+	  if (!n) {
+		  fill_padding(axis, pad, fallback == PaddingFallback::Opaque ? Block::blocks::STONE : Block::blocks::AIR);
+		  return;
+	  }
+	  if (n->padded) {
+		  copy_padding(axis, pad, *n->padded, src + 1);
+		  return;
+	  }
+	  if (n->block_types.is_uniform()) {
+		  fill_padding(axis, pad, static_cast<Block::blocks>(n->block_types.uniform_type()));
+		  return;
+	  }
+
+	  for (int u = 0; u < CS; u++) {
+		  for (int v = 0; v < CS; v++) {
+			  glm::ivec3 p, q;
+			  p[axis] = pad;  p[(axis + 1) % 3] = u + 1; p[(axis + 2) % 3] = v + 1;
+			  q[axis] = src;  q[(axis + 1) % 3] = u;     q[(axis + 2) % 3] = v;
+			  write_padded(p.x, p.y, p.z, n->get_block_type(q.x, q.y, q.z));
+		  }
+	  }
+  }
+
+  // Records the neighbour borders the next mesh is built against
+  void record_meshed_borders() noexcept {
+	  for (int face = 0; face < 6; face++)
+		  meshed_borders[face] = neighbours[face] ? neighbours[face]->border_generation[face ^ 1] : NO_NEIGHBOUR;
+  }
+
+  // The neighbour on `face` is resident and its border isn't the one the mesh was built against.
+  // A missing neighbour never is: the mesh keeps whatever it assumed until one arrives
+  bool border_changed(int face) const noexcept {
+	  const Chunk* n = neighbours[face];
+	  return n && n->border_generation[face ^ 1] != meshed_borders[face];
+  }
+
   inline int get_index(const int& x, const int& y, const int& z) const noexcept {
-    return x + (y << LOG_SIZE.x) + (z << (LOG_SIZE.x + LOG_SIZE.y));
+    return x + CHUNK_SIZE.x * (y + CHUNK_SIZE.y * z);
   }
 
   bool has_any_blocks() const noexcept { return non_air_count > 0; }
@@ -140,11 +355,87 @@ public:
   // Flags for the ChunkManager's update loop
   bool changed = true;       // Set to true initially to force first GPU upload
   bool in_dirty_list = false; // Prevents adding the same chunk to the dirty list twi
-  persistent_ssbo block_ssbo = persistent_ssbo(sizeof(block_types));
   int non_air_count = 0;
-  alignas(16) std::uint8_t block_types[SIZE]{};
+  // Bit f set: the boundary layer on face f is entirely opaque (see solid_boundary_faces()).
+  // Conservative, edits clear bits but never set them
+  std::uint8_t solid_faces = 0;
+  // Bumped on every change to the boundary layer on face f, 0 is as generated
+  std::array<std::uint32_t, 6> border_generation{};
+  // neighbours[f]->border_generation[f ^ 1] when the current mesh was built, NO_NEIGHBOUR if there
+  // was none. Starts at 0: generated meshes see the generator's border, same as an unedited neighbour
+  static constexpr std::uint32_t NO_NEIGHBOUR = ~0u;
+  std::array<std::uint32_t, 6> meshed_borders{};
+  // Blocks differ from what the generator produced, so it can't be asked for them again
+  bool edited = false;
+  // Level of detail the chunk is (or is about to be) meshed at, 0 is full detail; set by the ChunkManager
+  std::uint8_t lod = 0;
+  PaletteStorage<SIZE> block_types;
+  std::unique_ptr<PaddedBlocks> padded;
+
+  // Resident face neighbours in FACE_NORMALS order, maintained by the ChunkManager
+  std::array<Chunk*, 6> neighbours{};
 
   // Chunk-space position
   glm::ivec3 position;
   AABB aabb;
+
+private:
+  // x, y, z are padded coordinates in [0, CS_P)
+  inline void write_padded(int x, int y, int z, Block::blocks type) noexcept {
+	  padded->voxels[get_zxy_index(x, y, z)] = static_cast<std::uint8_t>(type);
+	  const std::uint64_t bit = 1ull << z;
+	  std::uint64_t& column = padded->opaque_mask[(y * CS_P) + x];
+	  column = type != Block::blocks::AIR ? (column | bit) : (column & ~bit);
+  }
+
+  // Sets the CS x CS slab at padded layer `pad` along `axis` to one type
+  void fill_padding(int axis, int pad, Block::blocks type) noexcept {
+	  constexpr std::uint64_t INTERIOR = ((1ull << CS) - 1) << 1;
+	  const bool solid = type != Block::blocks::AIR;
+	  if (axis == 2) {
+		  const std::uint64_t bit = 1ull << pad;
+		  for (int y = 1; y <= CS; y++) {
+			  for (int x = 1; x <= CS; x++) {
+				  padded->voxels[get_zxy_index(x, y, pad)] = static_cast<std::uint8_t>(type);
+				  std::uint64_t& row = padded->opaque_mask[(y * CS_P) + x];
+				  row = solid ? (row | bit) : (row & ~bit);
+			  }
+		  }
+		  return;
+	  }
+	  for (int i = 1; i <= CS; i++) {
+		  const int x = axis == 0 ? pad : i, y = axis == 0 ? i : pad;
+		  std::memset(&padded->voxels[get_zxy_index(x, y, 1)], static_cast<std::uint8_t>(type), CS);
+		  std::uint64_t& row = padded->opaque_mask[(y * CS_P) + x];
+		  row = solid ? (row | INTERIOR) : (row & ~INTERIOR);
+	  }
+  }
+
+  // Copies the slab at padded layer `layer` of `src` into ours at `pad`, both along `axis`.
+  // x and y slabs are made of whole z rows; a z slab is one byte and one mask bit per row
+  void copy_padding(int axis, int pad, const PaddedBlocks& src, int layer) noexcept {
+	  constexpr std::uint64_t INTERIOR = ((1ull << CS) - 1) << 1;
+	  if (axis == 2) {
+		  for (int y = 1; y <= CS; y++) {
+			  for (int x = 1; x <= CS; x++) {
+				  const int i = (y * CS_P) + x;
+				  padded->voxels[get_zxy_index(x, y, pad)] = src.voxels[get_zxy_index(x, y, layer)];
+				  padded->opaque_mask[i] = (padded->opaque_mask[i] & ~(1ull << pad)) | ((src.opaque_mask[i] >> layer & 1) << pad);
+			  }
+		  }
+		  return;
+	  }
+	  for (int i = 1; i <= CS; i++) {
+		  const int x = axis == 0 ? pad : i, y = axis == 0 ? i : pad;
+		  const int sx = axis == 0 ? layer : i, sy = axis == 0 ? i : layer;
+		  std::memcpy(&padded->voxels[get_zxy_index(x, y, 1)], &src.voxels[get_zxy_index(sx, sy, 1)], CS);
+		  std::uint64_t& row = padded->opaque_mask[(y * CS_P) + x];
+		  row = (row & ~INTERIOR) | (src.opaque_mask[(sy * CS_P) + sx] & INTERIOR);
+	  }
+  }
+
+  inline void mirror_to_neighbour(int face, int x, int y, int z, Block::blocks type) noexcept {
+	  if (Chunk* n = neighbours[face]; n && n->padded)
+		  n->write_padded(x, y, z, type);
+  }
 };
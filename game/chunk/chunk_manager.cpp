@@ -1,4 +1,16 @@
 module;
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
 #if defined(TRACY_ENABLE)
 #include <tracy/Tracy.hpp>
 #endif
@@ -7,176 +19,396 @@ module chunk_manager;
 import timer;
 import logger;
 
+// Every block type has to fit in a chunk's palette
+static_assert(static_cast<int>(Block::blocks::MAX_BLOCKS) - 1 <= PALETTE_SIZE);
+static_assert(LOD_BURIED_TYPE == static_cast<std::uint8_t>(Block::blocks::STONE));
+
+static CullPlanes cull_planes(const FrustumVolume& fv) noexcept
+{
+	CullPlanes planes;
+	for (int i = 0; i < 6; i++) {
+		const FrustumVolume::FrustumPlane& plane = fv.planes[i];
+		planes[i] = { { plane.equation.x, plane.equation.y, plane.equation.z }, plane.equation.w };
+	}
+	return planes;
+}
+
 ChunkManager::ChunkManager()
 	: noise(92368123),
+#if defined(COMPACT_QUADS)
+	shader2("Chunk2", SHADERS_DIRECTORY / "main_compact.vs", SHADERS_DIRECTORY / "main.fs")
+#else
 	shader2("Chunk2", SHADERS_DIRECTORY / "main.vs", SHADERS_DIRECTORY / "main.fs")
+#endif
 {
-	mainThreadMeshData.opaqueMask = new uint64_t[CS_P2] { 0 };
-	mainThreadMeshData.faceMasks = new uint64_t[CS_2 * 6] { 0 };
-	mainThreadMeshData.forwardMerged = new uint8_t[CS_2] { 0 };
-	mainThreadMeshData.rightMerged = new uint8_t[CS] { 0 };
-	mainThreadMeshData.vertices = new std::vector<uint64_t>(100000);
-	mainThreadMeshData.maxVertices = 100000;
+	workerScratch.resize(jobs.worker_count());
 
 	chunkRenderer.init();
 
+	// Spawn area, generated on the workers but integrated before the first frame
 	int size = 4;
-	for (std::uint32_t x = 0; x < size; x++) {
-		for (std::uint32_t z = 0; z < size; z++) {
-      std::uint32_t y = 0; // flat Y for now
-
-      std::memset(mainThreadMeshData.opaqueMask, 0, CS_P2 * sizeof(uint64_t));
-
-			// Allocate voxel array for this chunk
-			std::vector<std::uint8_t> voxels(CS_P3, 0);
-			// Fill terrain
-			// noise_2.generateTerrainV2(voxels.data(), mainThreadMeshData.opaqueMask, x, z, 30);
-			// ────────────────────────────────────────────────
-			//   1. World-space starting coordinate
-			// ────────────────────────────────────────────────
-			float worldStartX = x * float(CS);     // ← important: CS, not CS_P
-			float worldStartZ = z * float(CS);
-
-			std::vector<float> noise_data(CS_P3, 0);
-			noise_2.gen_uniform_3d(noise_data, worldStartX, 0.0f, worldStartZ, CS_P, 1.0f, 30);
-
-			// Optional: scale amplitude / remap to more useful range
-			// You can multiply or remap here if needed
-			// for (auto& v : noiseData) v = (v + 1.0f) * 0.5f;   // → [0..1]
-
-			// ────────────────────────────────────────────────
-			//   3. Voxel filling logic (same as before)
-			// ────────────────────────────────────────────────
-			for (int lx = 0; lx < CS_P; lx++) {
-				for (int ly = CS_P - 1; ly >= 0; ly--) {     // ← better to go top→bottom
-					for (int lz = 0; lz < CS_P; lz++) {
-						int idx = get_zxy_index(lx, ly, lz);
-						float heightNoise = noise_data[idx];
-
-						// Simple height-based threshold
-						// You can make this more sophisticated later
-						bool shouldBeSolid = heightNoise > (float(ly) / float(CS_P));
-
-						if (shouldBeSolid) {
-							int idx_above = get_zxy_index(lx, ly + 1, lz);
-							mainThreadMeshData.opaqueMask[(ly * CS_P) + lx] |= (1ULL << lz);
-
-							// Simple surface / subsurface logic
-							if (voxels[idx_above] == 0) {
-								voxels[idx] = 3;           // grass / surface
-							} else {
-								voxels[idx] = 2;           // dirt / stone
-							}
-						}
-						// Fill bedrock / deep stone below sea level
-						else if (ly < 25) {
-							mainThreadMeshData.opaqueMask[(ly * CS_P) + lx] |= (1ULL << lz);
-							voxels[idx] = 1;               // stone
+	for (int x = 0; x < size; x++)
+		for (int z = 0; z < size; z++)
+			request_chunk(glm::ivec3(x, 0, z));
+	jobs.wait_idle();
+
+	const auto drop = [this](GeneratedChunk&& chunk) { drop_generated_chunk(chunk); };
+	chunksInFlight -= uploads.collect(drop);
+	while (uploads.next_bytes(drop)) {
+		GeneratedChunk chunk = uploads.pop();
+		integrate_chunk(chunk);
+	}
+}
+MeshArena* ChunkManager::acquire_mesh_arena() noexcept
+{
+	if (freeMeshArenas.empty())
+		return meshArenas.emplace_back(std::make_unique<MeshArena>()).get();
+	MeshArena* arena = freeMeshArenas.back();
+	freeMeshArenas.pop_back();
+	return arena;
+}
+void ChunkManager::release_mesh_arena(MeshArena* arena) noexcept
+{
+	freeMeshArenas.push_back(arena);
+}
+void ChunkManager::generate_column(const glm::ivec2& column, ColumnData& out) noexcept
+{
+	// ─────────────────────────────────────────────────────────────
+	//               TUNABLE TERRAIN PARAMETERS
+	// ─────────────────────────────────────────────────────────────
+	constexpr float BASE_HEIGHT      = 32.0f;   // Approximate "sea level" / reference height
+	constexpr float HEIGHT_AMPLITUDE = 48.0f;   // Height swing of the hilliest terrain
+	constexpr float PLAINS_FACTOR    = 0.35f;   // Fraction of the amplitude left in the flattest biome
+	constexpr float BIOME_STEP       = 0.25f;   // Biomes change a lot slower than the terrain
+
+	// Runs on the workers: only reads the noise generators. The padded grid starts one block
+	// before the column, so the borders match what the neighbouring columns generate
+	std::vector<float> heightNoise(CS_P2), biomeNoise(CS_P2);
+	const float worldStartX = column.x * float(CS) - 1.0f;
+	const float worldStartZ = column.y * float(CS) - 1.0f;
+	noise_2.gen_uniform_2d(heightNoise, worldStartX, worldStartZ, CS_P, CS_P, 1.0f, 30);
+	noise_2.gen_uniform_2d(biomeNoise, worldStartX * BIOME_STEP, worldStartZ * BIOME_STEP, CS_P, CS_P, BIOME_STEP, 31);
+
+	for (int i = 0; i < CS_P2; i++) {
+		const float hilliness = glm::clamp(biomeNoise[i] * 0.5f + 0.5f, 0.0f, 1.0f);
+		const float amplitude = HEIGHT_AMPLITUDE * (PLAINS_FACTOR + (1.0f - PLAINS_FACTOR) * hilliness);
+		const int height = static_cast<int>(glm::floor(BASE_HEIGHT + heightNoise[i] * amplitude));
+
+		out.hilliness[i] = hilliness;
+		out.heights[i] = static_cast<std::int16_t>(height);
+		out.min_height = std::min(out.min_height, height);
+		out.max_height = std::max(out.max_height, height);
+	}
+}
+bool ChunkManager::generate_terrain(const glm::ivec3& chunkPos, const ColumnData& column, DensityField& density, PaddedBlocks& out) noexcept
+{
+	constexpr int SEA_LEVEL = 24;                      // Below this, empty space is filled with stone
+	constexpr int OVERHANG = 12;                       // How far (in blocks) the 3D noise moves the surface in the hilliest biome
+	constexpr float OVERHANG_FREQUENCY = 1.0f / 32.0f; // A power of two keeps lattice positions exact in every chunk
+
+	// World y of padded y = 0. The padding is filled too: the column knows what the
+	// neighbours hold, so unedited chunk borders mesh without hidden faces
+	const int worldStartY = chunkPos.y * CS - 1;
+	const int worldEndY = worldStartY + CS_P - 1;
+	if (worldStartY >= std::max(column.max_height + OVERHANG, SEA_LEVEL))
+		return false; // all air, out is left untouched
+
+	std::memset(out.voxels, 0, sizeof(out.voxels));
+	std::memset(out.opaque_mask, 0, sizeof(out.opaque_mask));
+
+	// Solid where height - y + noise * OVERHANG * hilliness > 0. The noise only comes from a
+	// coarse lattice; a chunk that sits entirely below the lowest surface it could push
+	// doesn't even sample that
+	if (worldEndY < column.min_height - OVERHANG) {
+		density.prepare_unsampled();
+	} else {
+		int lx, ly, lz;
+		density.align(chunkPos.x * CS - 1, worldStartY, chunkPos.z * CS - 1, lx, ly, lz);
+		const float f = OVERHANG_FREQUENCY;
+		noise_2.gen_grid_3d(density.lattice(), lx * f, ly * f, lz * f,
+				density.count_xz(), density.count_y(), density.count_xz(),
+				density.step_xz() * f, density.step_y() * f, density.step_xz() * f, 32);
+		density.prepare();
+	}
+
+	// Cell by cell: the cell's noise bounds and its footprint's height range decide whether
+	// it's all solid, all air, or has to be evaluated voxel by voxel. The bounds keep a small
+	// margin so float rounding in the interpolation can never disagree with them
+	constexpr float MARGIN = 1e-3f;
+	int footMin[CS_P + 1], footMax[CS_P + 1];
+	float noiseRow[CS_P];
+	for (int cx = 0; cx < density.cells_xz(); cx++) {
+		int x0, x1;
+		density.cell_range_xz(cx, x0, x1);
+		if (x0 >= x1)
+			continue;
+
+		for (int cz = 0; cz < density.cells_xz(); cz++) {
+			int z0, z1;
+			density.cell_range_z(cz, z0, z1);
+			footMin[cz] = std::numeric_limits<int>::max();
+			footMax[cz] = std::numeric_limits<int>::min();
+			for (int pz = z0; pz < z1; pz++) {
+				for (int px = x0; px < x1; px++) {
+					const int height = column.heights[pz * CS_P + px];
+					footMin[cz] = std::min(footMin[cz], height);
+					footMax[cz] = std::max(footMax[cz], height);
+				}
+			}
+		}
+
+		for (int cy = 0; cy < density.cells_y(); cy++) {
+			int y0, y1;
+			density.cell_range_y(cy, y0, y1);
+			if (y0 >= y1)
+				continue;
+
+			std::uint64_t solid = 0, mixed = 0;
+			for (int cz = 0; cz < density.cells_xz(); cz++) {
+				int z0, z1;
+				density.cell_range_z(cz, z0, z1);
+				if (z0 >= z1)
+					continue;
+				const std::uint64_t bits = (z1 - z0 == 64 ? ~0ull : ((1ull << (z1 - z0)) - 1)) << z0;
+				const float lo = footMin[cz] - (worldStartY + y1 - 1) + std::min(density.cell_min(cx, cy, cz), 0.0f) * OVERHANG;
+				const float hi = footMax[cz] - (worldStartY + y0) + std::max(density.cell_max(cx, cy, cz), 0.0f) * OVERHANG;
+				if (lo > MARGIN)
+					solid |= bits;
+				else if (hi > -MARGIN)
+					mixed |= bits;
+			}
+
+			for (int py = y0; py < y1; py++) {
+				const float y = static_cast<float>(worldStartY + py);
+				for (int px = x0; px < x1; px++) {
+					std::uint64_t row = solid;
+					if (mixed) {
+						density.upsample_row(px, py, noiseRow);
+						for (std::uint64_t m = mixed; m; m &= m - 1) {
+							const int pz = std::countr_zero(m);
+							const int i = pz * CS_P + px;
+							if (column.heights[i] - y + noiseRow[pz] * OVERHANG * column.hilliness[i] > 0.0f)
+								row |= 1ull << pz;
 						}
 					}
+					out.opaque_mask[(py * CS_P) + px] = row;
 				}
 			}
+		}
+	}
 
-			// Mesh the chunk immediately
-			mesh(voxels.data(), mainThreadMeshData);
-
-			// Create draw commands
-      auto v = parse_xyz_key(get_xyz_key(x, y, z));
-      glm::ivec3 chunkPos(v.x, v.y, v.z);
-			// glm::ivec3 chunkPos = parse_xyz_key(get_xyz_key(x, y, z));
-			std::vector<DrawElementsIndirectCommand> commands(6);
-			for (int i = 0; i < 6; i++) {
-				if (mainThreadMeshData.faceVertexLength[i]) {
-          std::int32_t baseInstance = (i << 24) | (chunkPos.z << 16) | (chunkPos.y << 8) | chunkPos.x;
-					auto drawCommand = chunkRenderer.getDrawCommand(mainThreadMeshData.faceVertexLength[i], baseInstance);
-					commands[i] = drawCommand;
-					chunkRenderer.buffer(drawCommand, mainThreadMeshData.vertices->data() + mainThreadMeshData.faceVertexBegin[i]);
-				}
+	// Block types, top down so every row knows what's above it. Above the padded grid
+	// only the heightmap is known, which is enough to type the (never meshed) top padding
+	for (int py = CS_P - 1; py >= 0; py--) {
+		const int y = worldStartY + py;
+		for (int px = 0; px < CS_P; px++) {
+			std::uint64_t above = 0;
+			if (py + 1 < CS_P) {
+				above = out.opaque_mask[((py + 1) * CS_P) + px];
+			} else {
+				for (int pz = 0; pz < CS_P; pz++)
+					above |= std::uint64_t(y + 1 < column.heights[pz * CS_P + px]) << pz;
 			}
 
-			chunkRenderData.push_back({ chunkPos, commands });
+			std::uint64_t& row = out.opaque_mask[(py * CS_P) + px];
+			const std::uint64_t ground = row;
+			const std::uint64_t grass = y + 1 >= SEA_LEVEL ? ground & ~above : 0;
+			if (y < SEA_LEVEL)
+				row = ~0ull;
+
+			std::uint8_t* voxels = &out.voxels[get_zxy_index(px, py, 0)];
+			for (std::uint64_t m = row; m; m &= m - 1) {
+				const int pz = std::countr_zero(m);
+				const std::uint64_t bit = 1ull << pz;
+				if (!(ground & bit))
+					voxels[pz] = 1;                             // stone
+				else if (grass & bit)
+					voxels[pz] = 3;                             // grass / surface
+				else
+					voxels[pz] = 2;                             // dirt / stone
+			}
 		}
 	}
-
+	return true;
 }
-void ChunkManager::render_opaque(const Transform& ts, const FrustumVolume& fv) noexcept {
-	glm::ivec3 cameraChunkPos = glm::floor(ts.pos / glm::vec3(CS));
-	for (const auto& data : chunkRenderData) {
-		for (int i = 0; i < 6; i++) {
-			auto& d = data.faceDrawCommands[i];
-			if (d.indexCount > 0) {
-				chunkRenderer.addDrawCommand(d);
-				switch (i) {
-					case 0:
-						if (cameraChunkPos.y >= data.chunkPos.y) {
-							chunkRenderer.addDrawCommand(d);
-						}
-						break;
-
-					case 1:
-						if (cameraChunkPos.y <= data.chunkPos.y) {
-							chunkRenderer.addDrawCommand(d);
-						}
-						break;
-
-					case 2:
-						if (cameraChunkPos.x >= data.chunkPos.x) {
-							chunkRenderer.addDrawCommand(d);
-						}
-						break;
-
-					case 3:
-						if (cameraChunkPos.x <= data.chunkPos.x) {
-							chunkRenderer.addDrawCommand(d);
-						}
-						break;
+void ChunkManager::generate_chunk(const glm::ivec3& chunkPos, ColumnCache::Column& column, MeshArena& arena, int lod, bool meshOnly, std::uint64_t sequence, unsigned worker) noexcept
+{
+#if defined(TRACY_ENABLE)
+	ZoneScoped;
+#endif
+	WorkerScratch& scratch = workerScratch[worker];
+	PaddedBlocks& blocks = *scratch.blocks;
+
+	GeneratedChunk result{ chunkPos, &arena };
+	result.lod = static_cast<std::uint8_t>(lod);
+	result.meshOnly = meshOnly;
+	result.sequence = sequence;
+	const auto finish = [&] {
+		const std::size_t bytes = std::size_t(result.quadCount) * QUAD_SIZE;
+		uploads.push(chunkPos, sequence, bytes, std::move(result));
+	};
+	const ColumnData& columnData = ColumnCache::get(column, glm::ivec2(chunkPos.x, chunkPos.z),
+			[this](const glm::ivec2& c, ColumnData& out) { generate_column(c, out); });
+	const bool anySolid = generate_terrain(chunkPos, columnData, scratch.density, blocks);
+	const ChunkOccupancy occupancy = anySolid ? classify_occupancy(blocks) : ChunkOccupancy::Empty;
+	if (occupancy == ChunkOccupancy::Empty) {
+		finish();
+		return;
+	}
 
-					case 4:
-						if (cameraChunkPos.z >= data.chunkPos.z) {
-							chunkRenderer.addDrawCommand(d);
-						}
-						break;
+	// Opaque all the way through and walled in by opaque padding: not a single face can show
+	result.solidFaces = solid_boundary_faces(blocks);
+	result.buried = occupancy == ChunkOccupancy::Opaque;
+	for (int face = 0; face < 6 && result.buried; face++)
+		result.buried = is_layer_solid(blocks, face, (face & 1) ? 0 : CS_P - 1);
+
+	if (!result.buried) {
+		// Flat and flooded chunks repeat a lot, identical input is an identical mesh
+		result.meshKey = mesh_input_hash(blocks.voxels, lod);
+		if (!meshCache.find(result.meshKey, arena.data())) {
+			mesh_lod(blocks.voxels, blocks.opaque_mask, lod, arena, scratch.lodBlocks->voxels, scratch.lodBlocks->opaque_mask);
+			meshCache.insert(result.meshKey, arena.data());
+		}
+		result.quadCount = arena.quadCount();
+	}
+	if (meshOnly) {
+		finish();
+		return;
+	}
 
-					case 5:
-						if (cameraChunkPos.z <= data.chunkPos.z) {
-							chunkRenderer.addDrawCommand(d);
-						}
-						break;
-				}
+	for (int z = 0; z < CS; z++) {
+		for (int y = 0; y < CS; y++) {
+			for (int x = 0; x < CS; x++) {
+				const std::uint8_t type = blocks.voxels[get_zxy_index(x + 1, y + 1, z + 1)];
+				if (type == static_cast<std::uint8_t>(Block::blocks::AIR))
+					continue;
+				result.blocks.set(x + CS * (y + CS * z), type);
+				++result.nonAirCount;
 			}
 		}
 	}
+	result.blocks.compact();
+
+	finish();
+}
+void ChunkManager::link_neighbours(Chunk* chunk) noexcept
+{
+	for (int face = 0; face < 6; face++) {
+		Chunk* n = chunks.find(chunk->position + FACE_NORMALS[face]);
+		chunk->neighbours[face] = n;
+		chunk->refresh_padding(face, paddingFallback);
+		if (!n)
+			continue;
+		n->neighbours[face ^ 1] = chunk;
+		n->refresh_padding(face ^ 1, paddingFallback);
+		// A fresh chunk's border is the generator's, so this is only a neighbour that was meshed
+		// against the fallback or against an older, edited copy of this chunk
+		if (n->border_changed(face ^ 1)) {
+			drop_edited_mesh(n);
+			mark_dirty(n);
+		}
+	}
+}
+void ChunkManager::unlink_neighbours(Chunk* chunk) noexcept
+{
+	for (int face = 0; face < 6; face++) {
+		if (Chunk* n = chunk->neighbours[face]) {
+			n->neighbours[face ^ 1] = nullptr;
+			n->refresh_padding(face ^ 1, paddingFallback);
+			drop_edited_mesh(n);
+		}
+		chunk->neighbours[face] = nullptr;
+	}
+	drop_edited_mesh(chunk);
+	std::erase_if(pending_edits, [chunk](const BlockEdit& edit) { return edit.chunk == chunk; });
+}
+void ChunkManager::drop_edited_mesh(Chunk* chunk) noexcept
+{
+	// Its padding changed behind the cached face masks' back, the next update has to start over
+	for (EditedMesh& edited : edited_meshes)
+		if (edited.chunk == chunk)
+			edited.chunk = nullptr;
+}
+void ChunkManager::mark_dirty(Chunk* chunk) noexcept
+{
+	if (!chunk->in_dirty_list) {
+		dirty_chunks.emplace_back(chunk);
+		chunk->in_dirty_list = true;
+	}
+}
+void ChunkManager::render_opaque(const Transform& ts, const FrustumVolume& fv) noexcept {
+	const glm::ivec3 cameraChunkPos = glm::floor(ts.pos / glm::vec3(CS));
+	const CullPlanes frustum = cull_planes(fv);
+	// Into this frame's region of the mapped command buffer, culled again only when a mesh, the
+	// camera chunk or the frustum changed
+#if defined(REGION_BATCHES)
+	// The chunks uploaded since the last frame go into their regions, which are culled as a whole
+	regionBatches.flush(drawTable, chunkRenderer, renderOrigin);
+	const std::size_t count = drawTable.cull(region_of(cameraChunkPos), frustum, chunkRenderer.mappedCommands(), chunkRenderer.maxDrawCommands());
+#elif defined(COMPACT_QUADS)
+	const std::size_t count = drawTable.cull(cameraChunkPos, frustum, chunkRenderer.mappedCommands(), chunkRenderer.mappedPalettes(), chunkRenderer.maxDrawCommands());
+#else
+	const std::size_t count = drawTable.cull(cameraChunkPos, frustum, chunkRenderer.mappedCommands(), chunkRenderer.maxDrawCommands());
+#endif
 
 	// shader2.use();
-	chunkRenderer.render();
+	shader2.setIVec3("u_render_origin", renderOrigin);
+	chunkRenderer.render(count);
 }
 bool ChunkManager::update_block(glm::ivec3 world_pos, Block::blocks newType) noexcept
 {
-	// Chunk* chunk = getChunk(world_pos);
-	// if (!chunk)
-	// 	return false;
-	// glm::ivec3 localPos = world_to_local(world_pos);
-	//
-	// chunk->set_block_type(localPos.x, localPos.y, localPos.z, newType);
-	// if (!chunk->in_dirty_list) {
-	// 	dirty_chunks.emplace_back(chunk);
-	// 	chunk->in_dirty_list = true;
-	// }
-	// return true;
+	Chunk* chunk = getChunk(world_pos);
+	if (!chunk)
+		return false;
+	glm::ivec3 localPos = world_to_local(world_pos);
+
+	if (chunk->get_block_type(localPos.x, localPos.y, localPos.z) == newType)
+		return true;
+
+	chunk->set_block_type(localPos.x, localPos.y, localPos.z, newType);
+	pending_edits.push_back({ chunk, localPos });
+	mark_dirty(chunk);
+
+	// A border edit also lands in the neighbour's padding, so its mesh is stale too
+	for (int face = 0; face < 6; face++) {
+		const int axis = face < 2 ? 1 : face < 4 ? 0 : 2;
+		Chunk* n = chunk->neighbours[face];
+		if (n && localPos[axis] == ((face & 1) ? 0 : CS - 1)) {
+			pending_edits.push_back({ n, localPos - FACE_NORMALS[face] * CS });
+			mark_dirty(n);
+		}
+	}
+	return true;
 }
 
-void ChunkManager::generate_chunks(glm::vec3 playerPos, unsigned int renderDistance) noexcept
+void ChunkManager::generate_chunks(glm::vec3 playerPos, unsigned int renderDistance, const FrustumVolume& fv) noexcept
 {
 #if defined(TRACY_ENABLE)
 	ZoneScoped;
 #endif
 	glm::ivec3 playerChunk{world_to_chunk(playerPos)};
-
-	if (playerChunk != last_player_chunk_pos) {
-		load_around_pos(playerChunk, renderDistance);
-		unload_around_pos(playerChunk, renderDistance + 1);
+	renderDistance = std::min(renderDistance, static_cast<unsigned int>(MAX_RENDER_DISTANCE));
+
+	// Chunks evicted during the previous frame can't be referenced anymore
+	chunks.collect();
+	// Buffer space of meshes the cache evicted, possibly from a worker
+	meshCache.collect([this](const std::array<DrawArraysIndirectCommand, 6>& commands) {
+		for (const DrawArraysIndirectCommand& command : commands)
+			if (command.count > 0)
+				chunkRenderer.removeDrawCommand(command);
+	});
+	defragment_render_data();
+
+	if (playerChunk != last_player_chunk_pos || renderDistance != last_render_distance) {
+		const int dist = static_cast<int>(renderDistance);
+		streamer.recenter(playerChunk, dist, dist + 1);
 		last_player_chunk_pos = playerChunk;
+		last_render_distance = renderDistance;
+		recenter_render_origin(playerChunk);
+		update_lods();
+		uploads.recenter(playerChunk);
 	}
+	stream_chunks(fv);
 	update_meshes();
 }
 Chunk* ChunkManager::getChunk(glm::ivec3 world_pos) const noexcept
@@ -184,92 +416,419 @@ Chunk* ChunkManager::getChunk(glm::ivec3 world_pos) const noexcept
 #if defined(TRACY_ENABLE)
 	ZoneScoped;
 #endif
-	// auto it = chunks.find(world_to_chunk(world_pos));
-	// if (it != chunks.end())
-	// 	return it->second.get();
-	// else {
-  {
+	Chunk* chunk = chunks.find(world_to_chunk(world_pos));
 #if defined(DEBUG)
-		// log::system_error("ChunkManager", "Chunk at glm::vec3({}, {}, {}) not found!", world_pos.x, world_pos.y, world_pos.z);
+	// if (!chunk)
+	// 	log::system_error("ChunkManager", "Chunk at glm::vec3({}, {}, {}) not found!", world_pos.x, world_pos.y, world_pos.z);
 #endif
-		return nullptr;
-	}
+	return chunk;
 }
 void ChunkManager::update_mesh(Chunk *chunk) noexcept {
+#if defined(TRACY_ENABLE)
+	ZoneScoped;
+#endif
+	if (chunk->occupancy() == ChunkOccupancy::Empty) {
+		// Air has no faces: drop whatever mesh and padded storage it still has
+		drop_edited_mesh(chunk);
+		chunk->set_storage(ChunkStorage::Palette);
+		release_render_data(chunk->position);
+		return;
+	}
+	chunk->set_storage(ChunkStorage::Padded, paddingFallback);
+	chunk->record_meshed_borders();
+
+	if (chunk->lod > 0) {
+		// Far chunks aren't patched edit by edit, the whole chunk is downsampled again. The
+		// slot's quads are scaled, so they can't be the base of a later remesh()
+		drop_edited_mesh(chunk);
+		EditedMesh& slot = acquire_edited_mesh(chunk);
+		const std::uint64_t meshKey = mesh_input_hash(chunk->padded_voxels(), chunk->lod);
+		if (!meshCache.find(meshKey, slot.arena->data()))
+			mesh_lod(chunk->padded_voxels(), chunk->opaque_mask(), chunk->lod, *slot.arena, lodScratch->voxels, lodScratch->opaque_mask);
+		slot.chunk = nullptr;
+		slot.lastUse = 0;
+
+		upload_cached_mesh(chunk->position, meshKey, slot.arena->data(), 0x3f);
+		chunk->set_storage(ChunkStorage::Palette);
+		return;
+	}
 
+	std::size_t editCount = 0;
+	for (const BlockEdit& edit : pending_edits)
+		editCount += edit.chunk == chunk;
+
+	EditedMesh* edited = nullptr;
+	for (EditedMesh& slot : edited_meshes)
+		if (slot.chunk == chunk)
+			edited = &slot;
+
+	if (edited && editCount > 0 && editCount <= MAX_INCREMENTAL_EDITS) {
+		// Only the columns and layers around each edit are re-meshed, and only faces whose quads changed get re-uploaded.
+		// No hash and no cache: a few edited blocks are rarely anyone else's input, and the chunk's own slot is rewritten
+		// in place as long as nothing else holds it
+		int changedFaces = 0;
+		for (const BlockEdit& edit : pending_edits)
+			if (edit.chunk == chunk)
+				changedFaces |= remesh(chunk->padded_voxels(), chunk->opaque_mask(), edited->arena->data(), edit.localPos.x, edit.localPos.y, edit.localPos.z);
+		edited->lastUse = ++mesh_update_tick;
+		upload_mesh(chunk->position, edited->arena->data().vertices, edited->arena->data().faceVertexBegin,
+			edited->arena->data().faceVertexLength, changedFaces);
+		return;
+	}
+
+	const std::uint64_t meshKey = mesh_input_hash(chunk->padded_voxels(), chunk->lod);
+	edited = &acquire_edited_mesh(chunk);
+	// A cached mesh comes without face masks, the next edit has to start over
+	if (meshCache.find(meshKey, edited->arena->data()))
+		edited->chunk = nullptr;
+	else
+		mesh(chunk->padded_voxels(), chunk->opaque_mask(), edited->arena->data());
+	edited->lastUse = ++mesh_update_tick;
+
+	// An edit that was undone is back to a mesh that's still in the buffer. An edited chunk's upload isn't attached to
+	// the cache though, or the cache's reference would keep its next edit from rewriting the slot in place
+	upload_cached_mesh(chunk->position, meshKey, edited->arena->data(), 0x3f, editCount == 0);
+}
+ChunkManager::EditedMesh& ChunkManager::acquire_edited_mesh(Chunk* chunk) noexcept
+{
+	// Least recently used slot, buffers are allocated on first use
+	EditedMesh* lru = &edited_meshes[0];
+	for (EditedMesh& slot : edited_meshes)
+		if (slot.lastUse < lru->lastUse)
+			lru = &slot;
+
+	if (!lru->arena)
+		lru->arena = std::make_unique<MeshArena>();
+	lru->chunk = chunk;
+	return *lru;
+}
+std::size_t ChunkManager::upload_mesh(const glm::ivec3& chunkPos, const std::uint64_t* quads, const int* faceBegin, const int* faceLength, int faces) noexcept
+{
+#if defined(REGION_BATCHES)
+	// Queued for the chunk's region, render_opaque() flushes them
+	std::size_t bytes = 0;
+	for (int i = 0; i < 6; i++) {
+		if (!(faces >> i & 1))
+			continue;
+		regionBatches.update(chunkPos, i, quads + faceBegin[i], faceLength[i]);
+		bytes += std::size_t(faceLength[i]) * QUAD_SIZE;
+	}
+	return bytes;
+#else
+	const std::size_t row = drawTable.row(chunkPos);
+#if defined(COMPACT_QUADS)
+	// Every face indexes the chunk's one palette, when it changes the faces that didn't have to be uploaded have to be too
+	const QuadPalette palette = build_palette(quads, faceBegin, faceLength);
+	if (palette != std::as_const(drawTable).palette(row)) {
+		drawTable.palette(row) = palette;
+		faces = 0x3f;
+	}
+#endif
+	std::size_t bytes = 0;
+	for (int i = 0; i < 6; i++) {
+		if (!(faces >> i & 1))
+			continue;
+		DrawArraysIndirectCommand& command = drawTable.command(row, i);
+		command.baseInstance = pack_base_instance(i, chunkPos, renderOrigin);
+#if defined(COMPACT_QUADS)
+		compactQuads.resize(std::max<std::size_t>(compactQuads.size(), std::size_t(faceLength[i]) * 4));
+		const int count = compact_quads(quads + faceBegin[i], faceLength[i], i, palette, compactQuads.data());
+		chunkRenderer.updateDrawCommand(command, count, compactQuads.data());
+#else
+		const int count = faceLength[i];
+		chunkRenderer.updateDrawCommand(command, count, quads + faceBegin[i]);
+#endif
+		bytes += std::size_t(count) * QUAD_SIZE;
+	}
+	return bytes;
+#endif
+}
+std::size_t ChunkManager::upload_cached_mesh(const glm::ivec3& chunkPos, std::uint64_t key, const MeshData& mesh, int faces, bool attach) noexcept
+{
+#if defined(REGION_BATCHES)
+	// Batched quads carry their chunk's slot in the region, they're never drawn for another chunk
+	meshCache.insert(key, mesh);
+	return upload_mesh(chunkPos, mesh.vertices, mesh.faceVertexBegin, mesh.faceVertexLength, faces);
+#else
+	// Quads are chunk-local: an identical mesh that's already in the buffer is drawn from
+	// there, with this chunk's position in baseInstance
+	if (std::optional<std::array<DrawArraysIndirectCommand, 6>> shared = meshCache.uploaded(key)) {
+		const std::size_t row = drawTable.row(chunkPos);
+#if defined(COMPACT_QUADS)
+		// The same mesh, so the same palette its quads were packed with
+		drawTable.palette(row) = build_palette(mesh.vertices, mesh.faceVertexBegin, mesh.faceVertexLength);
+#endif
+		for (int i = 0; i < 6; i++) {
+			DrawArraysIndirectCommand& command = drawTable.command(row, i);
+			command.baseInstance = pack_base_instance(i, chunkPos, renderOrigin);
+			chunkRenderer.shareDrawCommand(command, (*shared)[i]);
+		}
+		return 0;
+	}
 
+	const std::size_t bytes = upload_mesh(chunkPos, mesh.vertices, mesh.faceVertexBegin, mesh.faceVertexLength, faces);
+	meshCache.insert(key, mesh);
+	if (!attach)
+		return bytes;
+
+	// The cache keeps its own reference, so the next chunk with this mesh can share it
+	// even after this one is remeshed or unloaded
+	std::array<DrawArraysIndirectCommand, 6> commands;
+	const std::size_t row = drawTable.row(chunkPos);
+	for (int i = 0; i < 6; i++)
+		commands[i] = std::as_const(drawTable).command(row, i);
+	if (meshCache.attach(key, commands))
+		for (const DrawArraysIndirectCommand& command : commands)
+			chunkRenderer.retainDrawCommand(command);
+	return bytes;
+#endif
 }
 
 void ChunkManager::update_meshes() noexcept
 {
-	// if (dirty_chunks.empty()) return;
-	//
-	// face_flags.bind_base(2);
-	// prefix.bind_base(5);
-	// group_totals.bind_base(6);
-	// temp_faces.bind_base(7);
-	// for (auto& chunk : dirty_chunks) {
-	// 	update_mesh(chunk);
-	// 	chunk->in_dirty_list = false;
-	// 	chunk->changed = false;
-	// }
-	// dirty_chunks.clear();
+	if (dirty_chunks.empty()) return;
+
+	for (auto& chunk : dirty_chunks) {
+		update_mesh(chunk);
+		chunk->in_dirty_list = false;
+		chunk->changed = false;
+	}
+	dirty_chunks.clear();
+	pending_edits.clear();
 }
-void ChunkManager::load_around_pos(glm::ivec3 playerChunkPos, unsigned int renderDistance) noexcept
+void ChunkManager::stream_chunks(const FrustumVolume& fv) noexcept
 {
 #if defined(TRACY_ENABLE)
-    ZoneScoped;
+	ZoneScoped;
 #endif
-
-    if (renderDistance == 0) return;
+	streamStats = {};
+	streamStats.queued_loads = streamer.queued_loads() + chunksInFlight + uploads.size() + lodRemeshes.size();
+	streamStats.queued_unloads = streamer.queued_unloads();
+	if (streamStats.queued_loads == 0 && streamStats.queued_unloads == 0)
+		return;
 
 	Timer chunksTimer("chunk_generation");
+	const auto start = std::chrono::steady_clock::now();
+	auto elapsed_ms = [&start] {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	};
+
+	// Unloads first, they're cheap and free up buffer space for the loads.
+	// Every frame does at least one piece of work so the queues always drain.
+	while (streamStats.unloaded == 0 || elapsed_ms() < streamBudget.frame_ms) {
+		std::optional<glm::ivec3> pos = streamer.pop_unload();
+		if (!pos)
+			break;
+		unload_chunk(*pos);
+		streamStats.unloaded++;
+	}
 
-	const int dist = static_cast<int>(renderDistance);
-	const int max_dist_square = dist * dist;
-
-	// ─────────────────────────────────────────────────────────────
-	//               TUNABLE TERRAIN PARAMETERS
-	// ─────────────────────────────────────────────────────────────
-
-															   // Height range & vertical distribution
-	constexpr float    BASE_HEIGHT           = 14.0f;      // Approximate "sea level" / reference height
-	constexpr float	   HEIGHT_AMPLITUDE     = 60.0f;
-	constexpr float    MAX_TERRAIN_HEIGHT    = 100;        // Max possible mountain peak height (world space)
-	constexpr float    MIN_TERRAIN_HEIGHT    = -20.0f;    // Lowest possible terrain floor (world space)
-
-	// Noise → height mapping
-	constexpr float    NOISE_TO_HEIGHT_SCALE = static_cast<float>(MAX_TERRAIN_HEIGHT - MIN_TERRAIN_HEIGHT);
-	constexpr float    NOISE_VERTICAL_OFFSET = MIN_TERRAIN_HEIGHT;  // Shifts the [-1..1] → desired range
+	// Keep the workers fed, but only a few jobs deep so the streamer's ranking still decides what runs next.
+	// Waiting chunks count too: each holds a mesh arena until it's uploaded.
+	// Level of detail changes get a quarter of the slots while there are any, so a player
+	// that keeps moving into new terrain doesn't starve them
+	const std::size_t maxInFlight = jobs.worker_count() * 4;
+	const std::size_t loadSlots = lodRemeshes.empty() ? maxInFlight : maxInFlight - maxInFlight / 4;
+	if (chunksInFlight + uploads.size() < loadSlots) {
+		// Re-ranked only with a slot to fill and time left, otherwise the last ranking goes on
+		if (elapsed_ms() < streamBudget.frame_ms)
+			streamer.prioritize(cull_planes(fv), static_cast<float>(CHUNK_SIZE));
+		while (chunksInFlight + uploads.size() < loadSlots) {
+			std::optional<glm::ivec3> pos = streamer.pop_load();
+			if (!pos)
+				break;
+			request_chunk(*pos);
+		}
+	}
+	while (chunksInFlight + uploads.size() < maxInFlight && !lodRemeshes.empty()) {
+		const glm::ivec3 pos = lodRemeshes.back();
+		lodRemeshes.pop_back();
+		if (chunks.contains(pos))
+			request_chunk(pos, true);
+	}
 
-	// Surface layering
-	constexpr int      DIRT_DEPTH            = 3;          // How many layers of dirt under grass
-	constexpr int      BEACH_DEPTH           = 1;          // (currently unused — can be used for sand/gravel later)
+	// Nearest first, and a mesh only goes if it fits in what's left of the upload budget. The
+	// first one always does, so a mesh bigger than the whole budget still gets through
+	const auto drop = [this](GeneratedChunk&& chunk) { drop_generated_chunk(chunk); };
+	chunksInFlight -= uploads.collect(drop);
+	while (const std::optional<std::size_t> bytes = uploads.next_bytes(drop)) {
+		if (streamStats.loaded > 0 &&
+				(elapsed_ms() >= streamBudget.frame_ms || streamStats.uploaded_bytes + *bytes > streamBudget.upload_bytes))
+			break;
+		GeneratedChunk chunk = uploads.pop();
+		streamStats.uploaded_bytes += integrate_chunk(chunk);
+		streamStats.loaded++;
+	}
 
-	// ─────────────────────────────────────────────────────────────
+	streamStats.ms = elapsed_ms();
+}
+void ChunkManager::request_chunk(const glm::ivec3& chunkPos, bool meshOnly) noexcept
+{
+	// A mesh-only request regenerates the blocks of a resident chunk to mesh them at its new level
+	const Chunk* resident = chunks.find(chunkPos);
+	if (resident && !meshOnly)
+		return;
+	const int lod = meshOnly ? resident->lod : lod_for_distance(lodSettings, chunk_distance(chunkPos));
+
+	// Held until the chunk is unloaded, or dropped when it's no longer wanted by the time it's generated.
+	// Mesh-only jobs hold their own reference until they're integrated
+	ColumnCache::Column* column = columns.acquire(glm::ivec2(chunkPos.x, chunkPos.z));
+
+	MeshArena* arena = acquire_mesh_arena();
+
+	++chunksInFlight;
+	const std::uint64_t sequence = ++requestSequence;
+	jobs.submit([this, chunkPos, column, arena, lod, meshOnly, sequence](unsigned worker) {
+		generate_chunk(chunkPos, *column, *arena, lod, meshOnly, sequence, worker);
+	});
+}
+float ChunkManager::chunk_distance(const glm::ivec3& chunkPos) const noexcept
+{
+	// Before the first recenter there's no player yet, everything is close
+	if (!streamer.active())
+		return 0.0f;
+	return glm::length(glm::vec3(chunkPos - last_player_chunk_pos));
+}
+void ChunkManager::update_lods() noexcept
+{
+	chunks.for_each([this](const glm::ivec3& chunkPos, Chunk& chunk) {
+		const int lod = select_lod(lodSettings, chunk.lod, chunk_distance(chunkPos));
+		if (lod == chunk.lod)
+			return;
+		chunk.lod = static_cast<std::uint8_t>(lod);
+
+		// Edited blocks only exist here, so those are re-meshed on the main thread; the rest
+		// are regenerated. Chunks with nothing drawn (empty, buried) stay that way at any level
+		if (chunk.edited)
+			mark_dirty(&chunk);
+#if defined(REGION_BATCHES)
+		else if (regionBatches.contains(chunkPos))
+#else
+		else if (drawTable.contains(chunkPos))
+#endif
+			lodRemeshes.push_back(chunkPos);
+	});
+}
+std::size_t ChunkManager::integrate_chunk(GeneratedChunk& generatedChunk) noexcept
+{
+	const glm::ivec3& chunkPos = generatedChunk.chunkPos;
+	// Only read below, and nothing acquires arenas until this returns
+	release_mesh_arena(generatedChunk.arena);
+
+	if (generatedChunk.meshOnly) {
+		columns.release(glm::ivec2(chunkPos.x, chunkPos.z));
+		// Unloaded or changed level again meanwhile, or edited since: its own blocks win over the generator's
+		Chunk* chunk = chunks.find(chunkPos);
+		if (!chunk || chunk->lod != generatedChunk.lod)
+			return 0;
+		if (chunk->edited) {
+			mark_dirty(chunk);
+			return 0;
+		}
+		if (generatedChunk.quadCount == 0) {
+			release_render_data(chunkPos);
+			return 0;
+		}
+		return upload_cached_mesh(chunkPos, generatedChunk.meshKey, generatedChunk.arena->data(), 0x3f);
+	}
 
+	// Left the load sphere while it was being generated, or was requested twice
+	if (chunks.contains(chunkPos) || (streamer.active() && !streamer.wants(chunkPos))) {
+		columns.release(glm::ivec2(chunkPos.x, chunkPos.z));
+		return 0;
+	}
 
-	// FIX 1: Use a CONSTANT range for normalization, NOT min_max from the generator
-	// For most FBM/Perlin, the raw range is approximately [-1.0, 1.0]
-	constexpr float GLOBAL_MIN = -1.0f;
-	constexpr float GLOBAL_MAX =  1.0f;
-	constexpr float GLOBAL_RANGE = GLOBAL_MAX - GLOBAL_MIN;
+	Chunk* chunk = chunks.insert(chunkPos, std::make_unique<Chunk>(chunkPos));
+	chunk->assign_blocks(std::move(generatedChunk.blocks), generatedChunk.nonAirCount, generatedChunk.solidFaces);
+	chunk->lod = generatedChunk.lod;
+	link_neighbours(chunk);
+
+	// The player may have moved across a ring while this was generated; the mesh below is
+	// still better than a hole until the re-mesh comes back
+	const int lod = select_lod(lodSettings, chunk->lod, chunk_distance(chunkPos));
+	if (lod != chunk->lod) {
+		chunk->lod = static_cast<std::uint8_t>(lod);
+		if (generatedChunk.quadCount > 0)
+			lodRemeshes.push_back(chunkPos);
+	}
 
+	// Its padding assumed unedited neighbours, a neighbour edited since has another border.
+	// A buried chunk only cares once that border isn't solid anymore
+	for (int face = 0; face < 6 && chunk->occupancy() != ChunkOccupancy::Empty; face++) {
+		if (!chunk->border_changed(face))
+			continue;
+		if (generatedChunk.buried && (chunk->neighbours[face]->solid_faces >> (face ^ 1) & 1))
+			continue;
+		mark_dirty(chunk);
+		break;
+	}
 
+	// Nothing to draw: no render data, no buffer space
+	if (generatedChunk.buried || generatedChunk.quadCount == 0)
+		return 0;
 
-	for (int dz = -dist; dz <= dist; ++dz)
-	{
-		for (int dy = -dist; dy <= dist; ++dy)
-		{
-			for (int dx = -dist; dx <= dist; ++dx)
-			{
-				if (dx*dx + dy*dy + dz*dz > max_dist_square) continue;
-				glm::ivec3 chunkPos = playerChunkPos + glm::ivec3(dx, dy, dz);
-			}
-		}
-	}
+	// The padding was generated from the column heightmaps, so the borders already match
+	// unedited neighbours and nobody else needs a remesh
+	return upload_cached_mesh(chunkPos, generatedChunk.meshKey, generatedChunk.arena->data(), 0x3f);
 }
-void ChunkManager::unload_around_pos(glm::ivec3 playerChunkPos, unsigned int unloadDistance) noexcept
+void ChunkManager::drop_generated_chunk(GeneratedChunk& generatedChunk) noexcept
 {
-
+	// A later request for the same chunk came back: give back what this one was handed
+	release_mesh_arena(generatedChunk.arena);
+	columns.release(glm::ivec2(generatedChunk.chunkPos.x, generatedChunk.chunkPos.z));
+}
+void ChunkManager::unload_chunk(const glm::ivec3& chunkPos) noexcept
+{
+	Chunk* chunk = chunks.find(chunkPos);
+	if (!chunk)
+		return;
+	if (chunk->in_dirty_list)
+		std::erase(dirty_chunks, chunk);
+	unlink_neighbours(chunk);
+	release_render_data(chunkPos);
+	chunks.erase(chunkPos);
+	columns.release(glm::ivec2(chunkPos.x, chunkPos.z));
+}
+void ChunkManager::release_render_data(const glm::ivec3& chunkPos) noexcept
+{
+#if defined(REGION_BATCHES)
+	regionBatches.remove(chunkPos);
+#else
+	drawTable.remove(chunkPos, [this](DrawArraysIndirectCommand& command) {
+		chunkRenderer.updateDrawCommand(command, 0, nullptr);
+	});
+#endif
+}
+void ChunkManager::defragment_render_data() noexcept
+{
+	const std::vector<QuadMove>& moves = chunkRenderer.defragment(DEFRAG_BYTES_PER_FRAME);
+	if (moves.empty())
+		return;
+
+	// Every command drawing from a moved slot: the chunks' and the mesh cache's
+	std::unordered_map<std::uint32_t, std::uint32_t> movedTo;
+	for (const QuadMove& move : moves)
+		movedTo.emplace(move.from, move.to);
+	const auto relocate = [&movedTo](DrawArraysIndirectCommand& command) {
+		if (command.count == 0)
+			return;
+		if (auto it = movedTo.find(command.first / 6); it != movedTo.end())
+			command.first = it->second * 6;
+	};
+	drawTable.for_each_command(relocate);
+	meshCache.relocate(relocate);
+}
+void ChunkManager::recenter_render_origin(const glm::ivec3& playerChunk) noexcept
+{
+	const glm::ivec3 offset = playerChunk - renderOrigin;
+	if (std::max({ std::abs(offset.x), std::abs(offset.y), std::abs(offset.z) }) <= RENDER_ORIGIN_SLACK)
+		return;
+
+	// Every command is repacked against the new origin, empty ones too since they keep their position
+	const glm::ivec3 oldOrigin = renderOrigin;
+	renderOrigin = playerChunk;
+	drawTable.for_each_command([&](DrawArraysIndirectCommand& command) {
+		command.baseInstance = pack_base_instance(command.baseInstance >> 24,
+			unpack_base_instance(command.baseInstance, oldOrigin), renderOrigin);
+	});
 }
@@ -1,6 +1,8 @@
 module;
 #include <cstdint>
 #include <limits>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 export module chunk_manager;
 
@@ -8,41 +10,37 @@ import core;
 import glm;
 import ecs_components;
 export import chunk;
+export import chunk_map;
 import noise;
 import ssbo;
 import aabb;
 import chunk_renderer;
+import buffer_allocator;
+import draw_table;
+import frustum_cull;
+import frame_ring;
+import upload_queue;
+export import chunk_streamer;
+import block_storage;
+import job_system;
+import column_cache;
+import density_field;
+import lod;
+import mesh_cache;
+import quad_format;
+import region_batches;
 import shader;
 import mesher;
 import noise_2;
 import utility;
 
-export struct ivec3_hash {
-	std::size_t operator()(const glm::ivec3& v) const noexcept
-	{
-		std::size_t x = static_cast<std::size_t>(v.x) + 0x80000000;
-		std::size_t y = static_cast<std::size_t>(v.y) + 0x80000000;
-		std::size_t z = static_cast<std::size_t>(v.z) + 0x80000000;
-
-		const std::size_t prime1 = 73856093;
-		const std::size_t prime2 = 19349663;
-		const std::size_t prime3 = 83492791;
-
-		return (x * prime1) ^ (y * prime2) ^ (z * prime3);
-	}
-};
-
 export class ChunkManager
 {
 	public:
 		ChunkManager();
 		~ChunkManager() noexcept { 
-			delete[] mainThreadMeshData.opaqueMask;
-			delete[] mainThreadMeshData.faceMasks;
-			delete[] mainThreadMeshData.forwardMerged;
-			delete[] mainThreadMeshData.rightMerged;
-			delete mainThreadMeshData.vertices;
-
+			// Workers use the scratch below and call back into this
+			jobs.wait_idle();
 		}
 
 		Shader& getShader2() noexcept { return shader2; }
@@ -51,12 +49,27 @@ export class ChunkManager
 		void render_opaque(const Transform& ts, const FrustumVolume& fv) noexcept;
 
 		bool update_block(glm::ivec3 world_pos, Block::blocks newType) noexcept;
-		void generate_chunks(glm::vec3 playerPos, unsigned int renderDistance) noexcept;
+		// Streams chunks in and out around the player within the per-frame budget, nearest and visible first
+		void generate_chunks(glm::vec3 playerPos, unsigned int renderDistance, const FrustumVolume& fv) noexcept;
 		Chunk* getChunk(glm::ivec3 world_pos) const noexcept;
 		void update_mesh(Chunk *chunk) noexcept;
 
 		const NoiseSystem& get_noise() const noexcept { return noise; }
 
+		StreamBudget& stream_budget() noexcept { return streamBudget; }
+		const StreamStats& stream_stats() const noexcept { return streamStats; }
+		MeshCacheStats mesh_cache_stats() const noexcept { return meshCache.get_stats(); }
+		BufferAllocatorStats buffer_stats() const noexcept { return chunkRenderer.getBufferStats(); }
+		int buffer_generation() const noexcept { return chunkRenderer.getBufferGeneration(); }
+		FrameRingStats command_ring_stats() const noexcept { return chunkRenderer.getCommandRingStats(); }
+		FrameRingStats staging_ring_stats() const noexcept { return chunkRenderer.getStagingRingStats(); }
+		const UploadQueueStats& upload_queue_stats() const noexcept { return uploads.get_stats(); }
+#if defined(REGION_BATCHES)
+		const RegionBatchStats& region_batch_stats() const noexcept { return regionBatches.get_stats(); }
+#endif
+		// Takes effect the next time the player crosses a chunk boundary
+		LodSettings& lod_settings() noexcept { return lodSettings; }
+
 	private:
 
 		//TODO: Maybe move this into a utils namespace or smth
@@ -82,24 +95,136 @@ export class ChunkManager
 		Noise			 noise_2;
 		Shader			 shader2;
 
-		std::vector<float> cachedNoiseRegion;
-		glm::ivec3         lastRegionSize  = {-1, -1, -1};
-		glm::ivec3         lastNoiseOrigin{-999999};
+		// Heightmaps shared by every chunk of a column, one reference per requested chunk
+		ColumnCache columns;
 
-		struct ChunkRenderData {
-			glm::ivec3 chunkPos = glm::ivec3(0);
-			std::vector<DrawElementsIndirectCommand> faceDrawCommands = std::vector<DrawElementsIndirectCommand>(6);
+		// A chunk that was recently edited keeps its last mesher output (face masks and quads)
+		// around, so the next single-block edit only re-meshes the few layers it touches
+		struct EditedMesh {
+			Chunk* chunk = nullptr;
+			std::unique_ptr<MeshArena> arena; // allocated on first use
+			std::uint64_t lastUse = 0;
+		};
+		static constexpr int EDITED_MESH_SLOTS = 4;
+		// Past this many edits in one frame a full mesh is cheaper than patching layer by layer
+		static constexpr std::size_t MAX_INCREMENTAL_EDITS = 16;
+
+		// Per-worker memory for generate_chunk(), indexed by the job's worker index
+		struct WorkerScratch {
+			std::unique_ptr<PaddedBlocks> blocks = std::make_unique<PaddedBlocks>();
+			DensityField density;
+			std::unique_ptr<PaddedBlocks> lodBlocks = std::make_unique<PaddedBlocks>(); // downsampled blocks for mesh_lod()
+		};
+
+		// What a worker hands back to the main thread: the packed blocks, and the quads in the
+		// arena the job was given, uploaded from there as they are.
+		// Empty chunks come back with neither; buried ones (opaque, and so is all of their
+		// padding) with blocks but no quads. A meshOnly job re-meshes a resident chunk at
+		// another level of detail, and only brings back quads
+		struct GeneratedChunk {
+			glm::ivec3 chunkPos;
+			MeshArena* arena = nullptr;
+			int quadCount = 0;
+			std::uint64_t meshKey = 0; // mesh_input_hash() of what was meshed
+			PaletteStorage<SIZE> blocks;
+			int nonAirCount = 0;
+			std::uint8_t solidFaces = 0;
+			bool buried = false;
+			std::uint8_t lod = 0;
+			bool meshOnly = false;
+			std::uint64_t sequence = 0; // of the request, a later one for the same chunk supersedes this
 		};
 
-		std::vector<ChunkRenderData> chunkRenderData;
-		MeshData mainThreadMeshData;
+		struct BlockEdit {
+			Chunk* chunk;
+			glm::ivec3 localPos; // may be -1 or CS on one axis for an edit in the padding
+		};
+
+		// Padding for faces whose neighbour isn't loaded, in meshes built on the main thread
+		PaddingFallback paddingFallback = PaddingFallback::Air;
+
+		// Meshes by input, shared by the workers and the main thread. Past that many bytes of
+		// quads the least recently used go
+		static constexpr std::size_t MESH_CACHE_BYTES = 32u << 20;
+		MeshCache meshCache{ MESH_CACHE_BYTES };
+		// Quads the renderer's defragment() may move per frame
+		static constexpr std::size_t DEFRAG_BYTES_PER_FRAME = 2u << 20;
+
+		// Every resident chunk, keyed by chunk-space position
+		ChunkMap<Chunk> chunks;
+		std::vector<Chunk*> dirty_chunks;
+		std::vector<BlockEdit> pending_edits;
+		EditedMesh edited_meshes[EDITED_MESH_SLOTS];
+		std::uint64_t mesh_update_tick = 0;
+
+		// Face draw commands of every chunk with a mesh, culled into the renderer's command buffer
+#if defined(REGION_BATCHES)
+		// With REGION_BATCHES a row is a region's, drawing all of its chunks
+		DrawTable drawTable{ float(CS * REGION_SIZE) };
+		RegionBatches regionBatches;
+#else
+		DrawTable drawTable{ float(CS) };
+#endif
 		ChunkRenderer chunkRenderer;
+		// Chunk the draw commands' baseInstance positions are relative to, moved to the player
+		// once they're RENDER_ORIGIN_SLACK chunks away so every loaded chunk stays in range
+		static constexpr int RENDER_ORIGIN_SLACK = 64;
+		// What generate_chunks() clamps the render distance to: a loaded chunk is at most one
+		// more than that from the player, its region's first chunk REGION_SIZE - 1 below it
+		static constexpr int MAX_RENDER_DISTANCE = BASE_INSTANCE_MAX - RENDER_ORIGIN_SLACK - REGION_SIZE - 1;
+		static_assert(RENDER_ORIGIN_SLACK + MAX_RENDER_DISTANCE + 1 <= BASE_INSTANCE_MAX);
+		static_assert(-RENDER_ORIGIN_SLACK - (MAX_RENDER_DISTANCE + 1) - (REGION_SIZE - 1) >= BASE_INSTANCE_MIN);
+		glm::ivec3 renderOrigin{ 0 };
+#if defined(COMPACT_QUADS)
+		std::vector<std::uint32_t> compactQuads; // one face's quads on their way to the renderer
+#endif
+
+		ChunkStreamer streamer;
+		StreamBudget streamBudget;
+		StreamStats streamStats;
+
+		LodSettings lodSettings;
+		std::vector<glm::ivec3> lodRemeshes; // unedited chunks whose level changed, re-meshed on the workers
+		std::unique_ptr<PaddedBlocks> lodScratch = std::make_unique<PaddedBlocks>(); // mesh_lod() of edited chunks
+
+		std::vector<WorkerScratch> workerScratch;
+		// One arena per job in flight or chunk waiting for upload, recycled by the main thread
+		std::vector<std::unique_ptr<MeshArena>> meshArenas;
+		std::vector<MeshArena*> freeMeshArenas;
+		// Generated, waiting for the upload budget, nearest to the player first
+		UploadQueue<GeneratedChunk> uploads;
+		std::size_t chunksInFlight = 0;          // submitted and not collected from uploads yet
+		std::uint64_t requestSequence = 0;
 
 		// initialize with a value that's != to any reasonable spawn chunk position
 		glm::ivec3 last_player_chunk_pos{std::numeric_limits<int>::min()};
+		unsigned int last_render_distance = 0;
 
 		void update_meshes() noexcept;
-		void load_around_pos(glm::ivec3 playerChunkPos, unsigned int renderDistance) noexcept;
-		void unload_around_pos(glm::ivec3 playerChunkPos, unsigned int unloadDistance) noexcept;
-
+		EditedMesh& acquire_edited_mesh(Chunk* chunk) noexcept;
+		std::size_t upload_mesh(const glm::ivec3& chunkPos, const std::uint64_t* quads, const int* faceBegin, const int* faceLength, int faces) noexcept;
+		// attach = false leaves the upload out of the cache, for chunks that are edited and rewritten in place
+		std::size_t upload_cached_mesh(const glm::ivec3& chunkPos, std::uint64_t key, const MeshData& mesh, int faces, bool attach = true) noexcept;
+		MeshArena* acquire_mesh_arena() noexcept;
+		void release_mesh_arena(MeshArena* arena) noexcept;
+		void generate_column(const glm::ivec2& column, ColumnData& out) noexcept;
+		bool generate_terrain(const glm::ivec3& chunkPos, const ColumnData& column, DensityField& density, PaddedBlocks& out) noexcept;
+		void generate_chunk(const glm::ivec3& chunkPos, ColumnCache::Column& column, MeshArena& arena, int lod, bool meshOnly, std::uint64_t sequence, unsigned worker) noexcept;
+		void link_neighbours(Chunk* chunk) noexcept;
+		void unlink_neighbours(Chunk* chunk) noexcept;
+		void drop_edited_mesh(Chunk* chunk) noexcept;
+		void mark_dirty(Chunk* chunk) noexcept;
+		void stream_chunks(const FrustumVolume& fv) noexcept;
+		void request_chunk(const glm::ivec3& chunkPos, bool meshOnly = false) noexcept;
+		float chunk_distance(const glm::ivec3& chunkPos) const noexcept;
+		void update_lods() noexcept;
+		std::size_t integrate_chunk(GeneratedChunk& chunk) noexcept;
+		void drop_generated_chunk(GeneratedChunk& chunk) noexcept;
+		void unload_chunk(const glm::ivec3& chunkPos) noexcept;
+		void release_render_data(const glm::ivec3& chunkPos) noexcept;
+		void defragment_render_data() noexcept;
+		void recenter_render_origin(const glm::ivec3& playerChunk) noexcept;
+
+		// Last, so the workers are gone before anything they touch
+		JobSystem jobs;
 };
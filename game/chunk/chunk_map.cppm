@@ -0,0 +1,228 @@
+module;
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+export module chunk_map;
+
+import glm;
+
+export {
+  // Packs a chunk-space position into 63 bits (21 signed bits per axis).
+  // The top bit is never set, which leaves room for the EMPTY / TOMBSTONE sentinels.
+  inline constexpr std::uint64_t pack_chunk_key(const glm::ivec3& pos) noexcept {
+    constexpr std::uint64_t AXIS_MASK = (1ull << 21) - 1;
+    return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(pos.x)) & AXIS_MASK) |
+           ((static_cast<std::uint64_t>(static_cast<std::uint32_t>(pos.y)) & AXIS_MASK) << 21) |
+           ((static_cast<std::uint64_t>(static_cast<std::uint32_t>(pos.z)) & AXIS_MASK) << 42);
+  }
+
+  // murmur3 fmix64: every input bit affects every output bit, so small signed
+  // coordinates around the origin spread evenly over the table.
+  inline constexpr std::uint64_t mix_chunk_key(std::uint64_t key) noexcept {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdull;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ull;
+    key ^= key >> 33;
+    return key;
+  }
+
+  struct ivec3_hash {
+    std::size_t operator()(const glm::ivec3& v) const noexcept {
+      return static_cast<std::size_t>(mix_chunk_key(pack_chunk_key(v)));
+    }
+  };
+
+  // Open-addressing (linear probing) table from chunk-space position to an owned T.
+  //
+  // find() is lock-free and allocation-free, so physics and raycasts can query it
+  // while other threads insert and erase. Writers are serialized on an internal mutex.
+  //
+  // Erased values and outgrown slot arrays are retired, not freed: a reader may still
+  // be looking at them. collect() frees everything retired before the previous
+  // collect(), so a pointer returned by find() stays valid until the owner has
+  // called collect() twice (the ChunkManager does it once per frame).
+  template <typename T>
+  class ChunkMap {
+  public:
+    explicit ChunkMap(std::size_t initial_capacity = 4096)
+      : current(new Table(std::bit_ceil(initial_capacity < MIN_CAPACITY ? MIN_CAPACITY : initial_capacity))) {}
+
+    ~ChunkMap() {
+      Table* t = current.load(std::memory_order_relaxed);
+      for (std::size_t i = 0; i <= t->mask; i++)
+        delete t->slots[i].value.load(std::memory_order_relaxed);
+      delete t;
+      collect();
+      collect();
+    }
+
+    ChunkMap(const ChunkMap&) = delete;
+    ChunkMap& operator=(const ChunkMap&) = delete;
+
+    T* find(const glm::ivec3& pos) const noexcept {
+      const std::uint64_t key = pack_chunk_key(pos);
+      const Table* t = current.load(std::memory_order_acquire);
+
+      for (std::size_t i = mix_chunk_key(key) & t->mask;; i = (i + 1) & t->mask) {
+        const std::uint64_t k = t->slots[i].key.load(std::memory_order_acquire);
+        if (k == key)
+          return t->slots[i].value.load(std::memory_order_acquire);
+        if (k == EMPTY)
+          return nullptr;
+      }
+    }
+
+    bool contains(const glm::ivec3& pos) const noexcept { return find(pos) != nullptr; }
+
+    // Returns the resident value for pos. If pos was already present the passed value is dropped.
+    T* insert(const glm::ivec3& pos, std::unique_ptr<T> value) {
+      std::scoped_lock lock(write_mutex);
+      const std::uint64_t key = pack_chunk_key(pos);
+
+      if (T* existing = find_locked(key))
+        return existing;
+
+      if (used + 1 > max_load(current.load(std::memory_order_relaxed)))
+        rebuild();
+
+      Table* t = current.load(std::memory_order_relaxed);
+      std::size_t i = mix_chunk_key(key) & t->mask;
+      while (t->slots[i].key.load(std::memory_order_relaxed) != EMPTY)
+        i = (i + 1) & t->mask;
+
+      // Publish the value before the key so a reader that sees the key sees the value
+      T* raw = value.release();
+      t->slots[i].value.store(raw, std::memory_order_release);
+      t->slots[i].key.store(key, std::memory_order_release);
+      ++used;
+      live.fetch_add(1, std::memory_order_relaxed);
+      return raw;
+    }
+
+    // Tombstones are never reused (only dropped by a rebuild), so a reader can't
+    // observe a slot whose key and value belong to two different chunks.
+    bool erase(const glm::ivec3& pos) {
+      std::scoped_lock lock(write_mutex);
+      const std::uint64_t key = pack_chunk_key(pos);
+      Table* t = current.load(std::memory_order_relaxed);
+
+      for (std::size_t i = mix_chunk_key(key) & t->mask;; i = (i + 1) & t->mask) {
+        const std::uint64_t k = t->slots[i].key.load(std::memory_order_relaxed);
+        if (k == EMPTY)
+          return false;
+        if (k != key)
+          continue;
+
+        retired_values.push_back(t->slots[i].value.exchange(nullptr, std::memory_order_acq_rel));
+        t->slots[i].key.store(TOMBSTONE, std::memory_order_release);
+        live.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+
+    // Frees what was retired before the previous call. Call once per frame.
+    void collect() {
+      std::scoped_lock lock(write_mutex);
+      for (T* v : grace_values)
+        delete v;
+      grace_values = std::exchange(retired_values, {});
+      grace_tables = std::exchange(retired_tables, {});
+    }
+
+    // Visits a snapshot of the live entries; fn(const glm::ivec3&, T&)
+    template <typename Fn>
+    void for_each(Fn&& fn) const {
+      const Table* t = current.load(std::memory_order_acquire);
+      for (std::size_t i = 0; i <= t->mask; i++) {
+        const std::uint64_t k = t->slots[i].key.load(std::memory_order_acquire);
+        if (k == EMPTY || k == TOMBSTONE)
+          continue;
+        if (T* v = t->slots[i].value.load(std::memory_order_acquire))
+          fn(unpack_chunk_key(k), *v);
+      }
+    }
+
+    std::size_t size() const noexcept { return live.load(std::memory_order_relaxed); }
+    std::size_t capacity() const noexcept { return current.load(std::memory_order_relaxed)->mask + 1; }
+
+  private:
+    static constexpr std::uint64_t EMPTY = ~0ull;
+    static constexpr std::uint64_t TOMBSTONE = ~0ull - 1;
+    static constexpr std::size_t MIN_CAPACITY = 64;
+
+    struct Slot {
+      std::atomic<std::uint64_t> key{EMPTY};
+      std::atomic<T*> value{nullptr};
+    };
+
+    struct Table {
+      explicit Table(std::size_t capacity) : mask(capacity - 1), slots(new Slot[capacity]) {}
+      std::size_t mask;
+      std::unique_ptr<Slot[]> slots;
+    };
+
+    static constexpr std::size_t max_load(const Table* t) noexcept { return ((t->mask + 1) * 3) / 4; }
+
+    static glm::ivec3 unpack_chunk_key(std::uint64_t key) noexcept {
+      // Shift each 21-bit field to the top of an int64 and back down to sign-extend it
+      return {
+        static_cast<int>(static_cast<std::int64_t>(key << 43) >> 43),
+        static_cast<int>(static_cast<std::int64_t>(key << 22) >> 43),
+        static_cast<int>(static_cast<std::int64_t>(key << 1) >> 43)
+      };
+    }
+
+    T* find_locked(std::uint64_t key) const noexcept {
+      const Table* t = current.load(std::memory_order_relaxed);
+      for (std::size_t i = mix_chunk_key(key) & t->mask;; i = (i + 1) & t->mask) {
+        const std::uint64_t k = t->slots[i].key.load(std::memory_order_relaxed);
+        if (k == key)
+          return t->slots[i].value.load(std::memory_order_relaxed);
+        if (k == EMPTY)
+          return nullptr;
+      }
+    }
+
+    // Copies the live entries into a fresh table (dropping tombstones) sized so
+    // that it is at most a quarter full, then swaps it in.
+    void rebuild() {
+      Table* old = current.load(std::memory_order_relaxed);
+      const std::size_t n = live.load(std::memory_order_relaxed) + 1;
+      std::size_t capacity = old->mask + 1;
+      while (n * 4 > capacity)
+        capacity *= 2;
+
+      auto* t = new Table(capacity);
+      for (std::size_t i = 0; i <= old->mask; i++) {
+        const std::uint64_t k = old->slots[i].key.load(std::memory_order_relaxed);
+        if (k == EMPTY || k == TOMBSTONE)
+          continue;
+        std::size_t j = mix_chunk_key(k) & t->mask;
+        while (t->slots[j].key.load(std::memory_order_relaxed) != EMPTY)
+          j = (j + 1) & t->mask;
+        t->slots[j].value.store(old->slots[i].value.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        t->slots[j].key.store(k, std::memory_order_relaxed);
+      }
+
+      used = n - 1;
+      current.store(t, std::memory_order_release);
+      retired_tables.emplace_back(old);
+    }
+
+    std::atomic<Table*> current;
+    std::atomic<std::size_t> live{0};
+    std::size_t used = 0; // live + tombstones, guarded by write_mutex
+    std::mutex write_mutex;
+
+    std::vector<T*> retired_values;
+    std::vector<T*> grace_values;
+    std::vector<std::unique_ptr<Table>> retired_tables;
+    std::vector<std::unique_ptr<Table>> grace_tables;
+  };
+}
@@ -1,33 +1,77 @@
 module;
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
+#include <optional>
+#include <unordered_map>
 #include <vector>
 export module chunk_renderer;
 
 import mesher;
 import logger;
-
-static constexpr int BUFFER_SIZE = 5e8; // 500 mb
-static constexpr std::uint32_t QUAD_SIZE = 8;
+import buffer_allocator;
+import frame_ring;
+import quad_format;
+export import draw_command;
+
+static constexpr int BUFFER_SIZE = 5e8; // 500 mb, as far as the quad buffer grows
+// The quad buffer starts at generation 0 and doubles with each one up to BUFFER_SIZE
+static constexpr std::size_t FIRST_BUFFER_SIZE = 1 << 25; // 32 mb
+static constexpr int MAX_GENERATION = 4;
+static_assert((FIRST_BUFFER_SIZE << MAX_GENERATION) >= BUFFER_SIZE);
+// defragment() runs while the holes below the last slot are more than 1 / HOLE_FRACTION of it
+static constexpr std::uint32_t HOLE_FRACTION = 8;
+// Quads a re-uploaded face's slot has room for beyond its own, see editHeadroom()
+static constexpr std::uint32_t MIN_EDIT_HEADROOM = 16;
+
+static constexpr std::size_t bufferBytes(int generation) {
+  return std::min<std::size_t>(FIRST_BUFFER_SIZE << generation, BUFFER_SIZE) / QUAD_SIZE * QUAD_SIZE;
+}
 static constexpr int MAX_DRAW_COMMANDS = 100000;
-
-struct BufferSlot {
-  std::uint32_t startByte;
-  std::uint32_t sizeBytes;
+// Frames the CPU may be ahead of the GPU: the command buffer and the staging buffer quads are
+// uploaded through have a region for each
+static constexpr std::size_t FRAMES_IN_FLIGHT = 3;
+// Room for a chunk's whole mesh, whatever else was uploaded in the frame
+static constexpr std::size_t STAGING_REGION_BYTES = 8u << 20;
+static_assert(STAGING_REGION_BYTES >= std::size_t(MAX_QUADS) * QUAD_SIZE);
+
+// FrameRing's fences, GL sync objects
+struct GlFences {
+  using Fence = GLsync;
+
+  Fence insert() { return glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0); }
+  bool signalled(Fence fence) {
+    const GLenum status = glClientWaitSync(fence, 0, 0);
+    return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+  }
+  void wait(Fence fence) {
+    // The first wait flushes, so the fence is sure to be signalled eventually
+    GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+    while (glClientWaitSync(fence, flags, 1'000'000) == GL_TIMEOUT_EXPIRED)
+      flags = 0;
+  }
+  void release(Fence fence) { glDeleteSync(fence); }
 };
 
-export struct DrawElementsIndirectCommand {
-  std::uint32_t indexCount;    // (count) Quad count * 6
-  std::uint32_t instanceCount; // 1
-  std::uint32_t firstIndex;    // 0
-  std::uint32_t baseQuad;      // (baseVertex) Starting index in the SSBO
-  std::uint32_t baseInstance;  // Chunk x, y z, face index
+struct BufferSlot {
+  std::uint32_t handle;   // in the allocator
+  std::uint32_t quads;    // capacity, may be more than the command draws
+  std::uint32_t refs = 1; // draw commands pointing at it, see shareDrawCommand()
 };
 
-struct BufferFit {
-  std::uint32_t pos;
-  std::uint32_t space;
-  std::vector<BufferSlot>::iterator iter;
+#if defined(COMPACT_QUADS)
+// After a frame's commands, each one's chunk palette; main_compact.vs reads them by gl_DrawID
+static constexpr std::size_t DRAW_BYTES = sizeof(DrawArraysIndirectCommand) + sizeof(QuadPalette);
+// Where the palettes start has to do as a shader storage binding offset
+static_assert(MAX_DRAW_COMMANDS * sizeof(DrawArraysIndirectCommand) % 256 == 0);
+#else
+static constexpr std::size_t DRAW_BYTES = sizeof(DrawArraysIndirectCommand);
+#endif
+
+// A slot defragment() moved, by start quad (first / 6)
+export struct QuadMove {
+  std::uint32_t from;
+  std::uint32_t to;
 };
 
 export class ChunkRenderer {
@@ -36,48 +80,30 @@ public:
     glGenVertexArrays(1, &VAO);
     glBindVertexArray(VAO);
     glGenBuffers(1, &commandBuffer);
-    glGenBuffers(1, &SSBO);
-    glBindBuffer(GL_SHADER_STORAGE_BUFFER, SSBO);
+    SSBO = createQuadBuffer(bufferBytes(generation));
 
-    // Allocate buffer with persistent/coherent flags
-    glBufferStorage(GL_SHADER_STORAGE_BUFFER, BUFFER_SIZE, nullptr,
+    glGenBuffers(1, &stagingBuffer);
+    glBindBuffer(GL_COPY_READ_BUFFER, stagingBuffer);
+    glBufferStorage(GL_COPY_READ_BUFFER, stagingRing.size(), nullptr,
         GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
-
-    // Map it once and keep the pointer
-    ssbo_ptr = glMapBufferRange(
-        GL_SHADER_STORAGE_BUFFER, 0, BUFFER_SIZE,
-        GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT
-        );
-
-    glGenBuffers(1, &IBO);
-    int maxQuads = CS * CS * CS * 6;
-    std::vector<std::uint32_t> indices;
-    for (std::uint32_t i = 0; i < maxQuads; i++) {
-      indices.push_back((i << 2) | 2u);
-      indices.push_back((i << 2) | 0u);
-      indices.push_back((i << 2) | 1u);
-      indices.push_back((i << 2) | 1u);
-      indices.push_back((i << 2) | 3u);
-      indices.push_back((i << 2) | 2u);
-    }
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(std::uint32_t), indices.data(), GL_STATIC_DRAW);
+    staging_ptr = static_cast<std::uint8_t*>(glMapBufferRange(GL_COPY_READ_BUFFER, 0, stagingRing.size(),
+        GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT));
 
     glBindVertexArray(VAO);
     glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
     glBufferStorage(
         GL_DRAW_INDIRECT_BUFFER,
-        MAX_DRAW_COMMANDS * sizeof(DrawElementsIndirectCommand),
+        commandRing.size(),
         nullptr,
         GL_MAP_WRITE_BIT |
         GL_MAP_PERSISTENT_BIT |
         GL_MAP_COHERENT_BIT
         );
 
-    command_ptr = (DrawElementsIndirectCommand*)glMapBufferRange(
+    command_ptr = (DrawArraysIndirectCommand*)glMapBufferRange(
         GL_DRAW_INDIRECT_BUFFER,
         0,
-        MAX_DRAW_COMMANDS * sizeof(DrawElementsIndirectCommand),
+        commandRing.size(),
         GL_MAP_WRITE_BIT |
         GL_MAP_PERSISTENT_BIT |
         GL_MAP_COHERENT_BIT
@@ -86,156 +112,275 @@ public:
 
   // TODO: Deallocate buffers
   ~ChunkRenderer() {
-	  glBindBuffer(GL_SHADER_STORAGE_BUFFER, SSBO);
-	  glUnmapBuffer(GL_SHADER_STORAGE_BUFFER); // unmap before deletion
 	  glDeleteBuffers(1, &SSBO);
+	  glBindBuffer(GL_COPY_READ_BUFFER, stagingBuffer);
+	  glUnmapBuffer(GL_COPY_READ_BUFFER); // unmap before deletion
+	  glDeleteBuffers(1, &stagingBuffer);
   };
 
-  DrawElementsIndirectCommand getDrawCommand(int quadCount, std::uint32_t baseInstance) {
-    unsigned int requestedSize = quadCount * QUAD_SIZE;
-    BufferSlot slot;
+  // Quad space from the buffer's TLSF allocator, O(1), a slot of `capacity` quads if that's
+  // more than quadCount. A full buffer moves on to the next generation; at the last one it
+  // logs and returns an empty command, the chunk face just isn't drawn
+  DrawArraysIndirectCommand getDrawCommand(int quadCount, std::uint32_t baseInstance, std::uint32_t capacity = 0) {
+    capacity = std::max(capacity, static_cast<std::uint32_t>(quadCount));
+    std::optional<BufferAllocation> allocation = allocator.allocate(capacity);
+    while (!allocation && generation < MAX_GENERATION && resizeQuadBuffer(generation + 1))
+      allocation = allocator.allocate(capacity);
+    if (!allocation) {
+      const BufferAllocatorStats stats = allocator.get_stats();
+      log::system_error("chunk_renderer", "no buffer space for {} quads ({} of {} used, largest free {})",
+          quadCount, stats.used, stats.capacity, stats.largestFree);
+      return DrawArraysIndirectCommand{ 0, 0, 0, baseInstance };
+    }
+    slots.emplace(allocation->offset, BufferSlot{ allocation->handle, capacity });
+    return createCommand(allocation->offset, quadCount, baseInstance);
+  };
 
-    // Allocate at the end if possible
-    if ((BUFFER_SIZE - allocationEnd) > requestedSize) {
-      slot ={ allocationEnd, requestedSize };
-      usedSlots.emplace_back(slot);
-      allocationEnd += requestedSize;
-      return createCommand(slot, baseInstance);
+  // A shared slot is only freed with the last command pointing at it
+  void removeDrawCommand(const DrawArraysIndirectCommand& command) {
+    auto it = slots.find(command.first / 6);
+    if (command.count == 0 || it == slots.end())
+      return;
+    if (--it->second.refs == 0) {
+      allocator.free(it->second.handle);
+      slots.erase(it);
     }
+  }
 
-    // Otherwise, iterate through and find gaps to allocate in
-    // Slow!
+  // One more reference on the slot behind command, dropped again by removeDrawCommand()
+  void retainDrawCommand(const DrawArraysIndirectCommand& command) {
+    if (command.count == 0)
+      return;
+    if (auto it = slots.find(command.first / 6); it != slots.end())
+      it->second.refs++;
+  }
 
-    auto prev = usedSlots.begin();
-    BufferFit bestFit;
-    bool foundFit = false;
+  // Points command at the quads of source instead of its own, for identical meshes of
+  // different chunks: quads are chunk-local, only baseInstance (kept) tells them apart
+  void shareDrawCommand(DrawArraysIndirectCommand& command, const DrawArraysIndirectCommand& source) {
+    const std::uint32_t baseInstance = command.baseInstance;
+    if (command.count > 0 && command.first == source.first && command.count == source.count)
+      return;
+    if (command.count > 0)
+      removeDrawCommand(command);
+    retainDrawCommand(source);
+    command = source.count > 0 ? source : DrawArraysIndirectCommand{};
+    command.baseInstance = baseInstance;
+  }
 
-    unsigned int spaceInFront = usedSlots.front().startByte;
-    if (spaceInFront >= requestedSize) {
-      foundFit = true;
-      bestFit = BufferFit({
-        0,
-        spaceInFront,
-        usedSlots.begin()
-      });
+  // Replaces the quads behind command. They're written in place when they fit in the
+  // command's current slot (which keeps its size, so a face can grow back into it) and
+  // nothing shares that slot, otherwise the slot is released and a new one allocated.
+  // A face that's uploaded again is likely edited again, its new slot gets headroom
+  // (editHeadroom()) so the next edits that add a few quads still fit.
+  // A quadCount of 0 releases the slot and zeroes the command.
+  void updateDrawCommand(DrawArraysIndirectCommand& command, int quadCount, const void* quads) {
+    const std::uint32_t baseInstance = command.baseInstance;
+    const bool replacing = command.count > 0;
+
+    if (command.count > 0) {
+      auto it = slots.find(command.first / 6);
+      if (quadCount > 0 && it != slots.end() && it->second.refs == 1 && std::uint32_t(quadCount) <= it->second.quads) {
+        command.count = quadCount * 6;
+        buffer(command, quads);
+        return;
+      }
+      removeDrawCommand(command);
     }
 
-    if (usedSlots.size() == 1) {
-      slot = { usedSlots.back().startByte + usedSlots.back().sizeBytes, requestedSize };
-      usedSlots.insert(usedSlots.end(), slot);
-      return createCommand(slot, baseInstance);
+    if (quadCount == 0) {
+      command = {};
+      return;
     }
+    command = getDrawCommand(quadCount, baseInstance, replacing ? editHeadroom(quadCount) : 0);
+    buffer(command, quads);
+  }
 
-    for (auto it = usedSlots.begin() + 1; it != usedSlots.end(); ++it) {
-      unsigned int pos = (*prev).startByte + (*prev).sizeBytes;
-      unsigned int spaceBetween = (*it).startByte - pos;
-      if (spaceBetween >= requestedSize && (!foundFit || spaceBetween < bestFit.space)) {
-        foundFit = true;
-        bestFit = BufferFit({
-          pos,
-          spaceBetween,
-          it
-        });
-      }
-      prev = it;
-    }
+  // Slot size for a face of quadCount quads that's being edited: at least MIN_EDIT_HEADROOM
+  // more, or up to the allocator's size step, which it searches by anyway
+  static std::uint32_t editHeadroom(int quadCount) {
+    const std::uint32_t count = static_cast<std::uint32_t>(quadCount);
+    return std::max(BufferAllocator::round_up(count), count + MIN_EDIT_HEADROOM);
+  }
 
-    if (foundFit) {
-      slot = { bestFit.pos, requestedSize };
-      usedSlots.insert(bestFit.iter, slot);
-      return createCommand(slot, baseInstance);
+  // Incremental compaction, once a frame: moves up to budgetBytes of quads from the end of the
+  // buffer into the holes before it, then drops to the previous generation once everything
+  // fits in half of it. The draw commands pointing at a moved slot are the caller's to
+  // rewrite (first = to * 6), shared ones included, before the next render().
+  const std::vector<QuadMove>& defragment(std::size_t budgetBytes) {
+    moves.clear();
+    std::unordered_map<std::uint32_t, std::size_t> movedTo; // slot start -> its entry in moves
+    std::size_t movedBytes = 0;
+    while (movedBytes < budgetBytes) {
+      const std::uint32_t end = allocator.end();
+      if (end - allocator.get_stats().used <= end / HOLE_FRACTION)
+        break;
+      const std::optional<BufferMove> move = allocator.move_last();
+      if (!move)
+        break;
+
+      // Always to a lower free block, never overlapping
+      copyQuads(move->from, move->to, move->size);
+      auto slot = slots.extract(move->from);
+      slot.key() = move->to;
+      slot.mapped().handle = move->handle;
+      slots.insert(std::move(slot));
+
+      // A slot moved twice is reported once, from where its commands still point
+      if (auto it = movedTo.find(move->from); it != movedTo.end()) {
+        const std::size_t i = it->second;
+        movedTo.erase(it);
+        moves[i].to = move->to;
+        movedTo.emplace(move->to, i);
+      } else {
+        moves.push_back({ move->from, move->to });
+        movedTo.emplace(move->to, moves.size() - 1);
+      }
+      movedBytes += std::size_t(move->size) * QUAD_SIZE;
     }
 
-    slot = { usedSlots.back().startByte + usedSlots.back().sizeBytes, requestedSize };
-    usedSlots.insert(usedSlots.end(), slot);
-    return createCommand(slot, baseInstance);
-  };
+    if (generation > 0 && std::size_t(allocator.end()) * QUAD_SIZE <= bufferBytes(generation - 1) / 2)
+      resizeQuadBuffer(generation - 1);
+    return moves;
+  }
 
-  void removeDrawCommand(const DrawElementsIndirectCommand& command) {
-	  for (auto it = usedSlots.begin(); it != usedSlots.end(); ++it) {
-		  if ((*it).startByte == (command.baseQuad >> 2) * QUAD_SIZE) {
-			  // merge with previous if adjacent
-			  if (it != usedSlots.begin()) {
-				  auto prev = it - 1;
-				  if (prev->startByte + prev->sizeBytes == it->startByte) {
-					  prev->sizeBytes += it->sizeBytes;
-					  it = usedSlots.erase(it);
-				  }
-			  }
-
-			  // merge with next if adjacent
-			  if (it != usedSlots.end() - 1) {
-				  auto next = it + 1;
-				  if (it->startByte + it->sizeBytes == next->startByte) {
-					  it->sizeBytes += next->sizeBytes;
-					  usedSlots.erase(next);
-				  }
-			  }
-
-			  usedSlots.erase(it);
-			  return;
-		  }
-	  }
-  }
-
-  void buffer(const DrawElementsIndirectCommand& command, void* vertices) {
-    std::size_t offset = (command.baseQuad >> 2) * QUAD_SIZE;
-    std::size_t size = (command.indexCount / 6) * QUAD_SIZE;
-
-	  std::memcpy(static_cast<uint8_t*>(ssbo_ptr) + offset, vertices, size);
-  }
-
-  inline void addDrawCommand(const DrawElementsIndirectCommand& command) {
-    drawCommands.insert(drawCommands.end(), command);
-  };
+  BufferAllocatorStats getBufferStats() const { return allocator.get_stats(); }
+  int getBufferGeneration() const { return generation; }
+  FrameRingStats getCommandRingStats() const { return commandRing.get_stats(); }
+  FrameRingStats getStagingRingStats() const { return stagingRing.get_stats(); }
 
-  void render() {
-    log::system_info("chunk_renderer", "called");
+  // The quad buffer isn't mapped: quads go through this frame's region of the staging buffer
+  // and the GPU copies them over, in order with the draws of the frames before
+  void buffer(const DrawArraysIndirectCommand& command, const void* vertices) {
+    bufferQuads(command.first / 6, command.count / 6, vertices);
+  }
 
-    int numCommands = drawCommands.size();
+  // Like buffer(), to quadCount quads from startQuad on, which may be part of a slot
+  void bufferQuads(std::uint32_t startQuad, std::uint32_t quadCount, const void* vertices) {
+    std::size_t offset = std::size_t(startQuad) * QUAD_SIZE;
+    std::size_t size = std::size_t(quadCount) * QUAD_SIZE;
+    if (size == 0)
+      return;
 
-    if (numCommands == 0) {
+    const std::optional<std::size_t> staged = stagingRing.allocate(size, QUAD_SIZE);
+    if (!staged) {
+      log::system_error("chunk_renderer", "{} bytes of quads don't fit in a staging region", size);
       return;
     }
+    std::memcpy(staging_ptr + *staged, vertices, size);
+    glBindBuffer(GL_COPY_READ_BUFFER, stagingBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, SSBO);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, *staged, offset, size);
+  }
+
+  // quadCount quads from one place in the quad buffer to another that doesn't overlap it. On
+  // the GPU, after the draws that may still read what's overwritten
+  void copyQuads(std::uint32_t from, std::uint32_t to, std::uint32_t quadCount) {
+    glBindBuffer(GL_COPY_READ_BUFFER, SSBO);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, SSBO);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, std::size_t(from) * QUAD_SIZE,
+        std::size_t(to) * QUAD_SIZE, std::size_t(quadCount) * QUAD_SIZE);
+  }
+
+  // This frame's region of the persistently mapped indirect buffer, maxDrawCommands() long.
+  // The frame's commands are written straight into it, render() draws the first numCommands
+  DrawArraysIndirectCommand* mappedCommands() {
+    if (!commandOffset)
+      commandOffset = commandRing.allocate(MAX_DRAW_COMMANDS * DRAW_BYTES);
+    return command_ptr + *commandOffset / sizeof(DrawArraysIndirectCommand);
+  }
+#if defined(COMPACT_QUADS)
+  // The palettes of this frame's commands, the same index as the command
+  QuadPalette* mappedPalettes() {
+    return reinterpret_cast<QuadPalette*>(mappedCommands() + MAX_DRAW_COMMANDS);
+  }
+#endif
+  std::size_t maxDrawCommands() const { return MAX_DRAW_COMMANDS; }
+
+  // Ends the frame: the command and staging regions it wrote are fenced after the draw
+  void render(std::size_t numCommands) {
+    log::system_info("chunk_renderer", "called");
+
+    if (numCommands > 0 && commandOffset)
+      draw(numCommands);
+    commandRing.retire();
+    stagingRing.retire();
+    commandOffset.reset();
+  };
 
+private:
+  void draw(std::size_t numCommands) {
     glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
-    std::memcpy(command_ptr, drawCommands.data(), numCommands * sizeof(DrawElementsIndirectCommand));
 
     glBindVertexArray(VAO);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
     glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, SSBO);
+#if defined(COMPACT_QUADS)
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 1, commandBuffer,
+        *commandOffset + MAX_DRAW_COMMANDS * sizeof(DrawArraysIndirectCommand), numCommands * sizeof(QuadPalette));
+#endif
 
-    glMultiDrawElementsIndirect(
+    glMultiDrawArraysIndirect(
       GL_TRIANGLES,
-      GL_UNSIGNED_INT,
-      (void*)0,
-      numCommands,
+      reinterpret_cast<void*>(*commandOffset),
+      static_cast<int>(numCommands),
       0
     );
+  }
 
-    // clear but don't deallocate
-    drawCommands.clear();
-  };
+  // The quad buffer, only ever written by GPU copies
+  static unsigned int createQuadBuffer(std::size_t bytes) {
+    unsigned int buffer = 0;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, bytes, nullptr, 0);
+    return buffer;
+  }
 
-private:
-  DrawElementsIndirectCommand createCommand(BufferSlot& slot, std::uint32_t baseInstance) {
-	  DrawElementsIndirectCommand cmd;
-	  cmd.indexCount = (slot.sizeBytes / QUAD_SIZE) * 6;
+  // Persistent buffers can't be resized, so this makes a buffer of the other generation's size
+  // and has the GPU copy everything up to the last slot over. The CPU waits for that copy
+  // before the old buffer goes; generations change seldom enough for a one-off stall.
+  bool resizeQuadBuffer(int newGeneration) {
+    const std::size_t bytes = bufferBytes(newGeneration);
+    if (!allocator.resize(static_cast<std::uint32_t>(bytes / QUAD_SIZE)))
+      return false;
+
+    const unsigned int buffer = createQuadBuffer(bytes);
+    const std::size_t used = std::size_t(allocator.end()) * QUAD_SIZE;
+    if (used > 0) {
+      glBindBuffer(GL_COPY_READ_BUFFER, SSBO);
+      glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+      glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, used);
+    }
+    glFinish();
+
+    glDeleteBuffers(1, &SSBO);
+    SSBO = buffer;
+    generation = newGeneration;
+    log::system_info("chunk_renderer", "quad buffer generation {}: {} MB", generation, bytes >> 20);
+    return true;
+  }
+
+  DrawArraysIndirectCommand createCommand(std::uint32_t startQuad, int quadCount, std::uint32_t baseInstance) {
+	  DrawArraysIndirectCommand cmd;
+	  cmd.count = quadCount * 6;
 	  cmd.instanceCount = 1;
-	  cmd.firstIndex = 0;
-	  cmd.baseQuad = (slot.startByte / QUAD_SIZE) << 2;
+	  cmd.first = startQuad * 6;
 	  cmd.baseInstance = baseInstance;
 	  return cmd;
   }
 
   unsigned int VAO = 0;
-  unsigned int IBO = 0;
   unsigned int SSBO = 0;
   unsigned int commandBuffer = 0;
-
-  void* ssbo_ptr = nullptr;
-  DrawElementsIndirectCommand* command_ptr = nullptr;
-  std::vector<BufferSlot> usedSlots;
-  std::vector<DrawElementsIndirectCommand> drawCommands;
-  std::uint32_t allocationEnd = 0;
+  unsigned int stagingBuffer = 0;
+
+  std::uint8_t* staging_ptr = nullptr;
+  DrawArraysIndirectCommand* command_ptr = nullptr;
+  FrameRing<GlFences> commandRing{ MAX_DRAW_COMMANDS * DRAW_BYTES, FRAMES_IN_FLIGHT };
+  FrameRing<GlFences> stagingRing{ STAGING_REGION_BYTES, FRAMES_IN_FLIGHT };
+  std::optional<std::size_t> commandOffset; // of this frame's region, once mappedCommands() asked for it
+  int generation = 0;
+  BufferAllocator allocator{ static_cast<std::uint32_t>(bufferBytes(0) / QUAD_SIZE) };
+  std::unordered_map<std::uint32_t, BufferSlot> slots; // by start quad
+  std::vector<QuadMove> moves; // the last defragment()'s
 };
@@ -0,0 +1,182 @@
+module;
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+export module chunk_streamer;
+
+import glm;
+import frustum_cull;
+
+export {
+  // Per-frame limits for the main-thread side of streaming (unload, generate, mesh, upload)
+  struct StreamBudget {
+    double frame_ms = 4.0;
+    std::size_t upload_bytes = 8u << 20;
+  };
+
+  struct StreamStats {
+    std::size_t queued_loads = 0;
+    std::size_t queued_unloads = 0;
+    int loaded = 0;
+    int unloaded = 0;
+    std::size_t uploaded_bytes = 0;
+    double ms = 0.0;
+  };
+
+  // Tracks which chunk positions should be resident (a sphere around the player's chunk)
+  // and queues the ones that have to be streamed in or out.
+  //
+  // Moving the sphere only walks the difference between the old and the new sphere, one
+  // z span per (x, y) row, so a boundary crossing costs O(r^2) instead of O(r^3).
+  // Chunks are unloaded past keep_radius rather than load_radius, so walking back and
+  // forth over a boundary doesn't thrash the outermost shell.
+  class ChunkStreamer {
+  public:
+    // Queues positions entering the load sphere and positions leaving the keep sphere
+    void recenter(const glm::ivec3& new_center, int new_load_radius, int new_keep_radius) {
+      const bool first = !has_center;
+      for_each_difference(new_center, new_load_radius, center, load_radius, first,
+          [&](const glm::ivec3& pos) { loads.push_back({ pos, 0 }); });
+      if (!first)
+        for_each_difference(center, keep_radius, new_center, new_keep_radius, false,
+            [&](const glm::ivec3& pos) { unloads.push_back(pos); });
+
+      center = new_center;
+      load_radius = new_load_radius;
+      keep_radius = new_keep_radius;
+      has_center = true;
+      ranked = false;
+    }
+
+    // Drops queued loads that left the load sphere and moves the most urgent ones to the
+    // front: nearest first, with chunks outside frustum counted as 2x further away (chunk
+    // pos spans pos * chunk_size to (pos + 1) * chunk_size). Only the first BATCH entries are
+    // fully sorted; a frame never gets through more than that.
+    // The ranking is kept until a recenter(), a different frustum or the batch running out
+    // while loads are left, the calls in between return false without touching the queue.
+    bool prioritize(const CullPlanes& frustum, float chunk_size) {
+      const bool drained = next_load == BATCH && loads.size() > BATCH;
+      if (ranked && !drained && frustum == ranked_frustum)
+        return false;
+      ranked = true;
+      ranked_frustum = frustum;
+
+      loads.erase(loads.begin(), loads.begin() + next_load);
+      next_load = 0;
+      std::erase_if(loads, [this](const Load& load) { return !wants(load.pos); });
+
+      // The frustum test on all of them at once, see cull_bounds()
+      bounds.clear();
+      for (const Load& load : loads) {
+        const glm::vec3 min = glm::vec3(load.pos) * chunk_size;
+        const float lo[3] = { min.x, min.y, min.z };
+        const float hi[3] = { min.x + chunk_size, min.y + chunk_size, min.z + chunk_size };
+        bounds.push_back(lo, hi);
+      }
+      visible.resize(cull_mask_words(loads.size()));
+      cull_bounds(bounds, frustum, visible.data());
+
+      for (std::size_t i = 0; i < loads.size(); i++) {
+        const glm::ivec3 d = loads[i].pos - center;
+        const std::uint32_t dist2 = static_cast<std::uint32_t>(d.x * d.x + d.y * d.y + d.z * d.z);
+        loads[i].key = visible[i / 64] >> (i % 64) & 1 ? dist2 : dist2 * 4;
+      }
+
+      const auto by_key = [](const Load& a, const Load& b) { return a.key < b.key; };
+      const std::size_t batch = std::min(BATCH, loads.size());
+      if (batch < loads.size())
+        std::nth_element(loads.begin(), loads.begin() + batch, loads.end(), by_key);
+      std::sort(loads.begin(), loads.begin() + batch, by_key);
+      return true;
+    }
+
+    std::optional<glm::ivec3> pop_load() noexcept {
+      if (next_load == std::min(BATCH, loads.size()))
+        return std::nullopt;
+      return loads[next_load++].pos;
+    }
+
+    // Positions that left the keep sphere but may since have come back into it are skipped
+    std::optional<glm::ivec3> pop_unload() noexcept {
+      while (!unloads.empty()) {
+        const glm::ivec3 pos = unloads.back();
+        unloads.pop_back();
+        if (!keeps(pos))
+          return pos;
+      }
+      return std::nullopt;
+    }
+
+    // False until the first recenter()
+    bool active() const noexcept { return has_center; }
+    bool wants(const glm::ivec3& pos) const noexcept { return has_center && inside(pos - center, load_radius); }
+    bool keeps(const glm::ivec3& pos) const noexcept { return has_center && inside(pos - center, keep_radius); }
+
+    std::size_t queued_loads() const noexcept { return loads.size() - next_load; }
+    std::size_t queued_unloads() const noexcept { return unloads.size(); }
+
+  private:
+    static constexpr std::size_t BATCH = 1024;
+
+    struct Load {
+      glm::ivec3 pos;
+      std::uint32_t key;
+    };
+
+    static bool inside(const glm::ivec3& d, int radius) noexcept {
+      return d.x * d.x + d.y * d.y + d.z * d.z <= radius * radius;
+    }
+
+    // Half length of the z span of a sphere at row offset (dx, dy) from its center, -1 if the row misses it
+    static int z_span(int radius, int dx, int dy) noexcept {
+      const int rem = radius * radius - dx * dx - dy * dy;
+      if (rem < 0)
+        return -1;
+      int h = static_cast<int>(std::sqrt(static_cast<double>(rem)));
+      while (h * h > rem) --h;
+      while ((h + 1) * (h + 1) <= rem) ++h;
+      return h;
+    }
+
+    // Calls fn(pos) for every position in sphere a that isn't in sphere b (or every position of a if b_empty)
+    template <typename Fn>
+    static void for_each_difference(const glm::ivec3& a, int ra, const glm::ivec3& b, int rb, bool b_empty, Fn&& fn) {
+      for (int dx = -ra; dx <= ra; dx++) {
+        for (int dy = -ra; dy <= ra; dy++) {
+          const int ha = z_span(ra, dx, dy);
+          if (ha < 0)
+            continue;
+          const int x = a.x + dx, y = a.y + dy;
+          const int lo = a.z - ha, hi = a.z + ha;
+          const int hb = b_empty ? -1 : z_span(rb, x - b.x, y - b.y);
+
+          if (hb < 0) {
+            for (int z = lo; z <= hi; z++)
+              fn(glm::ivec3(x, y, z));
+            continue;
+          }
+          for (int z = lo; z <= std::min(hi, b.z - hb - 1); z++)
+            fn(glm::ivec3(x, y, z));
+          for (int z = std::max(lo, b.z + hb + 1); z <= hi; z++)
+            fn(glm::ivec3(x, y, z));
+        }
+      }
+    }
+
+    glm::ivec3 center{0};
+    int load_radius = 0;
+    int keep_radius = 0;
+    bool has_center = false;
+
+    std::vector<Load> loads;
+    std::size_t next_load = 0;
+    bool ranked = false;       // loads is ranked for ranked_frustum and the current center
+    CullPlanes ranked_frustum{};
+    ChunkBounds bounds;                 // of loads, while ranking them
+    std::vector<std::uint64_t> visible; // their frustum test, a bit each
+    std::vector<glm::ivec3> unloads;
+  };
+}
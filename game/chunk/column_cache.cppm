@@ -0,0 +1,67 @@
+module;
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+export module column_cache;
+
+import glm;
+import chunk_map;
+import mesher;
+
+export {
+  // Per (x, z) chunk column: the terrain height and biome parameters for every padded
+  // (x, z) of the column, shared by all the chunks stacked in it.
+  // Indexed [pz * CS_P + px]; padded x = 0 is world x chunk.x * CS - 1, like the voxels.
+  struct ColumnData {
+    std::vector<std::int16_t> heights = std::vector<std::int16_t>(CS_P2); // first air block, in world y
+    std::vector<float> hilliness = std::vector<float>(CS_P2);             // 0 = plains .. 1 = mountains
+    int min_height = std::numeric_limits<int>::max();
+    int max_height = std::numeric_limits<int>::min();
+  };
+
+  // Reference-counted column cache. The main thread acquire()s a column for every chunk it
+  // requests and release()s it when that chunk is unloaded or dropped; the last release
+  // evicts the column. The data itself is generated lazily by whichever worker needs it
+  // first, so a column costs one 2D noise grid however many chunks are stacked in it.
+  class ColumnCache {
+  public:
+    struct Column {
+      ColumnData data;
+      std::once_flag generated;
+      int refs = 0;
+    };
+
+    // Main thread. The returned pointer stays valid until the matching release()
+    Column* acquire(const glm::ivec2& column) {
+      std::unique_ptr<Column>& entry = columns[key(column)];
+      if (!entry)
+        entry = std::make_unique<Column>();
+      entry->refs++;
+      return entry.get();
+    }
+
+    // Main thread
+    void release(const glm::ivec2& column) {
+      auto it = columns.find(key(column));
+      if (it != columns.end() && --it->second->refs == 0)
+        columns.erase(it);
+    }
+
+    // Any thread: generate(column, data) runs once, the first time a column is needed
+    template <typename Generate>
+    static const ColumnData& get(Column& entry, const glm::ivec2& column, Generate&& generate) {
+      std::call_once(entry.generated, [&] { generate(column, entry.data); });
+      return entry.data;
+    }
+
+    std::size_t size() const noexcept { return columns.size(); }
+
+  private:
+    static std::uint64_t key(const glm::ivec2& column) noexcept { return pack_chunk_key(glm::ivec3(column.x, 0, column.y)); }
+
+    std::unordered_map<std::uint64_t, std::unique_ptr<Column>> columns;
+  };
+}
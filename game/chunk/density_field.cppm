@@ -0,0 +1,145 @@
+module;
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <vector>
+export module density_field;
+
+import mesher;
+
+export {
+  // Coarse 3D noise lattice over one padded chunk, trilinearly upsampled on demand.
+  //
+  // Lattice points sit on world coordinates that are multiples of step_xz on x / z and of
+  // step_y on y, so two chunks interpolate the same value for the same world voxel and
+  // their padding agrees. The padded grid starts up to one step past the first lattice
+  // point on each axis; a 4x8x4 lattice over CS_P = 64 is 18 * 10 * 18 samples instead
+  // of 64^3.
+  //
+  // Values are clamped to [-1, 1]. Trilinear interpolation never leaves the range of a
+  // cell's 8 corners, so cell_min() / cell_max() bound every voxel inside the cell, which
+  // is what lets the terrain skip whole cells that are provably solid or air.
+  class DensityField {
+  public:
+    // Both steps must divide CS_P
+    explicit DensityField(int step_xz = 4, int step_y = 8)
+      : sxz(step_xz), sy(step_y), cxz(CS_P / step_xz + 2), cy(CS_P / step_y + 2),
+      samples(cxz * cy * cxz), rows(cxz * cy * cxz), bounds(2 * cells_xz() * cells_y() * cells_xz()) {
+      assert(CS_P % step_xz == 0 && CS_P % step_y == 0);
+    }
+
+    int step_xz() const noexcept { return sxz; }
+    int step_y() const noexcept { return sy; }
+    int count_xz() const noexcept { return cxz; }
+    int count_y() const noexcept { return cy; }
+    int cells_xz() const noexcept { return cxz - 1; }
+    int cells_y() const noexcept { return cy - 1; }
+
+    // Aligns the lattice to a padded grid whose voxel 0 is at world (x, y, z).
+    // lattice_* is the world position of lattice point 0, where sampling has to start.
+    void align(int x, int y, int z, int& lattice_x, int& lattice_y, int& lattice_z) noexcept {
+      ox = floor_mod(x, sxz);
+      oy = floor_mod(y, sy);
+      oz = floor_mod(z, sxz);
+      lattice_x = x - ox;
+      lattice_y = y - oy;
+      lattice_z = z - oz;
+    }
+
+    // Fill this after align(), then call prepare(). Ordered ix + count_xz * (iy + count_y * iz),
+    // which is what FastNoise's GenUniformGrid3D writes for an (x, y, z) grid.
+    std::vector<float>& lattice() noexcept { return samples; }
+
+    // Clamps, transposes into z-contiguous rows and computes the per-cell bounds
+    void prepare() noexcept {
+      for (int iz = 0; iz < cxz; iz++)
+        for (int iy = 0; iy < cy; iy++)
+          for (int ix = 0; ix < cxz; ix++)
+            rows[(ix * cy + iy) * cxz + iz] = std::clamp(samples[ix + cxz * (iy + cy * iz)], -1.0f, 1.0f);
+
+      for (int cx = 0; cx < cells_xz(); cx++) {
+        for (int ccy = 0; ccy < cells_y(); ccy++) {
+          for (int cz = 0; cz < cells_xz(); cz++) {
+            float lo = 1.0f, hi = -1.0f;
+            for (int c = 0; c < 8; c++) {
+              const float v = rows[((cx + (c & 1)) * cy + ccy + (c >> 1 & 1)) * cxz + cz + (c >> 2)];
+              lo = std::min(lo, v);
+              hi = std::max(hi, v);
+            }
+            float* b = &bounds[2 * cell_index(cx, ccy, cz)];
+            b[0] = lo;
+            b[1] = hi;
+          }
+        }
+      }
+    }
+
+    // For a chunk that doesn't need the noise at all: every cell is bounded by [-1, 1]
+    void prepare_unsampled() noexcept {
+      std::fill(rows.begin(), rows.end(), 0.0f);
+      for (std::size_t i = 0; i < bounds.size(); i += 2) {
+        bounds[i] = -1.0f;
+        bounds[i + 1] = 1.0f;
+      }
+    }
+
+    float cell_min(int cx, int ccy, int cz) const noexcept { return bounds[2 * cell_index(cx, ccy, cz)]; }
+    float cell_max(int cx, int ccy, int cz) const noexcept { return bounds[2 * cell_index(cx, ccy, cz) + 1]; }
+
+    // Padded voxel range [begin, end) covered by cell c on x / z (cell_range_xz) or y (cell_range_y)
+    void cell_range_xz(int c, int& begin, int& end) const noexcept { cell_range(c, sxz, ox, begin, end); }
+    void cell_range_z(int c, int& begin, int& end) const noexcept { cell_range(c, sxz, oz, begin, end); }
+    void cell_range_y(int c, int& begin, int& end) const noexcept { cell_range(c, sy, oy, begin, end); }
+
+    // Interpolated values for the whole z row at padded (px, py): out[pz], pz in [0, CS_P).
+    // Bilinear across the 4 surrounding lattice rows, then linear along z; both loops are
+    // straight-line float math over contiguous arrays, which the compiler vectorizes.
+    void upsample_row(int px, int py, float* out) const noexcept {
+      const int lx = px + ox, ly = py + oy;
+      const int ix = lx / sxz, iy = ly / sy;
+      const float fx = float(lx - ix * sxz) / float(sxz);
+      const float fy = float(ly - iy * sy) / float(sy);
+
+      const float* r00 = &rows[(ix * cy + iy) * cxz];
+      const float* r10 = &rows[((ix + 1) * cy + iy) * cxz];
+      const float* r01 = &rows[(ix * cy + iy + 1) * cxz];
+      const float* r11 = &rows[((ix + 1) * cy + iy + 1) * cxz];
+
+      float column[CS_P + 2];
+      for (int iz = 0; iz < cxz; iz++) {
+        const float a = r00[iz] + (r10[iz] - r00[iz]) * fx;
+        const float b = r01[iz] + (r11[iz] - r01[iz]) * fx;
+        column[iz] = a + (b - a) * fy;
+      }
+
+      // The lattice row spans CS_P + step_xz voxels, the padded row starts oz into it
+      float full[2 * CS_P];
+      const float inv_step = 1.0f / float(sxz);
+      for (int iz = 0; iz < cxz - 1; iz++) {
+        const float base = column[iz];
+        const float slope = (column[iz + 1] - base) * inv_step;
+        float* o = full + iz * sxz;
+        for (int k = 0; k < sxz; k++)
+          o[k] = base + slope * float(k);
+      }
+      std::memcpy(out, full + oz, CS_P * sizeof(float));
+    }
+
+  private:
+    static int floor_mod(int a, int b) noexcept { return ((a % b) + b) % b; }
+
+    static void cell_range(int c, int step, int offset, int& begin, int& end) noexcept {
+      begin = std::max(c * step - offset, 0);
+      end = std::min((c + 1) * step - offset, CS_P);
+    }
+
+    int cell_index(int cx, int ccy, int cz) const noexcept { return (cx * cells_y() + ccy) * cells_xz() + cz; }
+
+    int sxz, sy;
+    int cxz, cy;
+    int ox = 0, oy = 0, oz = 0;
+    std::vector<float> samples;
+    std::vector<float> rows;   // [(ix * count_y + iy) * count_xz + iz]
+    std::vector<float> bounds; // min, max per cell
+  };
+}
@@ -0,0 +1,34 @@
+module;
+#include <cstdint>
+export module draw_command;
+
+import glm;
+
+export {
+  // Non-indexed: main.vs reads quad gl_VertexID / 6 from the SSBO, and its corner from
+  // gl_VertexID % 6
+  struct DrawArraysIndirectCommand {
+    std::uint32_t count;         // Quad count * 6
+    std::uint32_t instanceCount; // 1
+    std::uint32_t first;         // Start quad * 6
+    std::uint32_t baseInstance;  // Chunk x, y z, face index, see pack_base_instance()
+  };
+
+  // baseInstance holds the chunk relative to the render origin (u_render_origin in the
+  // shaders), 8 bits per axis in two's complement, so every chunk drawn has to be within
+  // [-128, 127] of it on each axis
+  constexpr int BASE_INSTANCE_MIN = -128;
+  constexpr int BASE_INSTANCE_MAX = 127;
+
+  // Face in bits 24-31, then z, y, x of chunk_pos - origin
+  inline std::uint32_t pack_base_instance(int face, const glm::ivec3& chunk_pos, const glm::ivec3& origin) noexcept {
+    const glm::ivec3 offset = chunk_pos - origin;
+    return std::uint32_t(face) << 24 | (std::uint32_t(offset.z) & 255u) << 16 | (std::uint32_t(offset.y) & 255u) << 8 |
+      (std::uint32_t(offset.x) & 255u);
+  }
+
+  // The chunk a baseInstance packed against origin draws
+  inline glm::ivec3 unpack_base_instance(std::uint32_t base_instance, const glm::ivec3& origin) noexcept {
+    return origin + glm::ivec3(std::int8_t(base_instance), std::int8_t(base_instance >> 8), std::int8_t(base_instance >> 16));
+  }
+}
@@ -0,0 +1,217 @@
+module;
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+export module draw_table;
+
+import glm;
+import chunk_map;
+import draw_command;
+import frustum_cull;
+import quad_format;
+
+export {
+  // The draw commands of every chunk with a mesh, one row per chunk, kept from frame to frame.
+  // Laid out by column: chunk positions in x / y / z arrays and each face's commands in an
+  // array of their own, so culling a face is a walk over two flat arrays, and the chunks'
+  // bounds next to them for the frustum test. With COMPACT_QUADS each row also keeps the
+  // palette its quads were packed with, handed out with every command of the row. Rows are
+  // swap-removed, a chunk's row number can change with every remove().
+  //
+  // Writing through command() or for_each_command() marks the table dirty; until then, or
+  // until the camera moves to another chunk or turns, cull() has nothing to redo.
+  class DrawTable {
+  public:
+    // chunk_size = world units per chunk, for the chunks' bounds
+    explicit DrawTable(float chunk_size) : chunkSize(chunk_size) {}
+
+    // Row of the chunk, a new one with empty commands if it had none
+    std::size_t row(const glm::ivec3& chunk_pos) {
+      auto [it, inserted] = index.try_emplace(chunk_pos, positions[0].size());
+      if (inserted) {
+        float min[3], max[3];
+        for (int axis = 0; axis < 3; axis++) {
+          positions[axis].push_back(chunk_pos[axis]);
+          min[axis] = chunk_pos[axis] * chunkSize;
+          max[axis] = min[axis] + chunkSize;
+        }
+        bounds.push_back(min, max);
+        for (std::vector<DrawArraysIndirectCommand>& commands : faces)
+          commands.push_back({});
+#if defined(COMPACT_QUADS)
+        palettes.push_back({});
+#endif
+        dirty = true;
+      }
+      return it->second;
+    }
+
+    bool contains(const glm::ivec3& chunk_pos) const { return index.contains(chunk_pos); }
+    std::size_t size() const noexcept { return positions[0].size(); }
+
+    DrawArraysIndirectCommand& command(std::size_t row, int face) noexcept {
+      dirty = true;
+      return faces[face][row];
+    }
+    const DrawArraysIndirectCommand& command(std::size_t row, int face) const noexcept { return faces[face][row]; }
+
+#if defined(COMPACT_QUADS)
+    QuadPalette& palette(std::size_t row) noexcept {
+      dirty = true;
+      return palettes[row];
+    }
+    const QuadPalette& palette(std::size_t row) const noexcept { return palettes[row]; }
+#endif
+
+    // Every command of every row, to rewrite in place
+    template <typename Fn>
+    void for_each_command(Fn&& fn) {
+      for (std::vector<DrawArraysIndirectCommand>& commands : faces)
+        for (DrawArraysIndirectCommand& command : commands)
+          fn(command);
+      dirty = true;
+    }
+
+    // Hands the chunk's commands to release(command), then drops its row
+    template <typename Release>
+    void remove(const glm::ivec3& chunk_pos, Release&& release) {
+      auto found = index.find(chunk_pos);
+      if (found == index.end())
+        return;
+      const std::size_t row = found->second;
+      index.erase(found);
+      for (std::vector<DrawArraysIndirectCommand>& commands : faces)
+        release(commands[row]);
+
+      // Swap-remove, the last row takes this one's number
+      const std::size_t last = size() - 1;
+      bounds.swap_remove(row);
+      if (row != last) {
+        for (std::vector<int>& axis : positions)
+          axis[row] = axis[last];
+        for (std::vector<DrawArraysIndirectCommand>& commands : faces)
+          commands[row] = commands[last];
+#if defined(COMPACT_QUADS)
+        palettes[row] = palettes[last];
+#endif
+        index[glm::ivec3(positions[0][row], positions[1][row], positions[2][row])] = row;
+      }
+      for (std::vector<int>& axis : positions)
+        axis.pop_back();
+      for (std::vector<DrawArraysIndirectCommand>& commands : faces)
+        commands.pop_back();
+#if defined(COMPACT_QUADS)
+      palettes.pop_back();
+#endif
+      dirty = true;
+    }
+
+    // Compacts the non-empty commands of the chunks in the frustum whose faces can be seen
+    // from camera_chunk (a +y face from its own chunk's height or above, and so on) into out,
+    // at most `capacity`. Returns how many there are. With the table, the camera chunk and the
+    // frustum as they were on the last call, the commands it found are copied to out as they
+    // are, or left there if out is one of the last OUT_SLOTS it wrote them to (the frame ring's
+    // regions, which only cull() writes). out is only written, never read, it may be
+    // write-combined memory. With COMPACT_QUADS, out_palettes gets each command's palette the
+    // same way, and goes with out.
+    std::size_t cull(const glm::ivec3& camera_chunk, const CullPlanes& frustum, DrawArraysIndirectCommand* out,
+#if defined(COMPACT_QUADS)
+        QuadPalette* out_palettes,
+#endif
+        std::size_t capacity) {
+      if (!dirty && camera_chunk == lastCamera && frustum == lastFrustum && culled.size() <= capacity) {
+        if (!holds_culled(out)) {
+          std::copy(culled.begin(), culled.end(), out);
+#if defined(COMPACT_QUADS)
+          std::copy(culledPalettes.begin(), culledPalettes.end(), out_palettes);
+#endif
+          wrote_culled(out);
+        }
+        return culled.size();
+      }
+
+      // One bit per row, then only the rows left are visited
+      visible.resize(cull_mask_words(size()));
+      cull_bounds(bounds, frustum, visible.data());
+      if (size() % 64)
+        visible.back() &= (std::uint64_t(1) << (size() % 64)) - 1;
+
+      culled.clear();
+#if defined(COMPACT_QUADS)
+      culledPalettes.clear();
+#endif
+      for (int face = 0; face < 6 && culled.size() < capacity; face++) {
+        const int axis = face < 2 ? 1 : face < 4 ? 0 : 2;
+        const int camera = camera_chunk[axis];
+        const int* position = positions[axis].data();
+        const DrawArraysIndirectCommand* commands = faces[face].data();
+        // -y, -x and -z faces show from the chunk's own layer or below
+        const bool negative = face & 1;
+
+        for (std::size_t word = 0; word < visible.size() && culled.size() < capacity; word++) {
+          for (std::uint64_t bits = visible[word]; bits && culled.size() < capacity; bits &= bits - 1) {
+            const std::size_t row = word * 64 + std::countr_zero(bits);
+            if (commands[row].count > 0 && (negative ? camera <= position[row] : camera >= position[row])) {
+              culled.push_back(commands[row]);
+#if defined(COMPACT_QUADS)
+              culledPalettes.push_back(palettes[row]);
+#endif
+            }
+          }
+        }
+      }
+      std::copy(culled.begin(), culled.end(), out);
+#if defined(COMPACT_QUADS)
+      std::copy(culledPalettes.begin(), culledPalettes.end(), out_palettes);
+#endif
+
+      dirty = false;
+      culledSet++;
+      wrote_culled(out);
+      lastCamera = camera_chunk;
+      lastFrustum = frustum;
+      return culled.size();
+    }
+
+  private:
+    // Where the current culled set was written, at least as many as the renderer has frames in flight
+    static constexpr std::size_t OUT_SLOTS = 4;
+    struct WrittenOut {
+      const DrawArraysIndirectCommand* out = nullptr;
+      std::uint64_t set = 0; // culledSet when it was written
+    };
+
+    bool holds_culled(const DrawArraysIndirectCommand* out) const noexcept {
+      return std::any_of(std::begin(writtenOuts), std::end(writtenOuts),
+          [&](const WrittenOut& written) { return written.out == out && written.set == culledSet; });
+    }
+    void wrote_culled(const DrawArraysIndirectCommand* out) noexcept {
+      writtenOuts[nextWrittenOut] = { out, culledSet };
+      nextWrittenOut = (nextWrittenOut + 1) % OUT_SLOTS;
+    }
+
+    std::vector<int> positions[3]; // chunk x, y, z per row
+    std::vector<DrawArraysIndirectCommand> faces[6];
+#if defined(COMPACT_QUADS)
+    std::vector<QuadPalette> palettes;
+#endif
+    std::unordered_map<glm::ivec3, std::size_t, ivec3_hash> index; // chunk position -> row
+    float chunkSize;
+    ChunkBounds bounds;
+    std::vector<std::uint64_t> visible; // the last cull's frustum test, a bit per row
+    std::vector<DrawArraysIndirectCommand> culled; // what the last cull found
+#if defined(COMPACT_QUADS)
+    std::vector<QuadPalette> culledPalettes;
+#endif
+
+    bool dirty = true;
+    std::uint64_t culledSet = 0; // bumped every time culled is recomputed
+    WrittenOut writtenOuts[OUT_SLOTS];
+    std::size_t nextWrittenOut = 0;
+    glm::ivec3 lastCamera{ 0 };
+    CullPlanes lastFrustum{};
+  };
+}
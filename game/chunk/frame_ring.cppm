@@ -0,0 +1,102 @@
+module;
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+export module frame_ring;
+
+export {
+  struct FrameRingStats {
+    std::size_t regions = 0;
+    std::size_t regionBytes = 0;
+    std::uint64_t retired = 0; // regions fenced and handed over to the GPU
+    std::uint64_t stalls = 0;  // regions whose fence wasn't signalled yet when they came round again
+  };
+
+  // A buffer split into equal regions the CPU writes one after the other while the GPU reads
+  // the ones before. A region is fenced when it's retired (its frame is over, or it's full), and
+  // that fence is waited for before the region is written again, so nothing the GPU may still
+  // read from is overwritten. With N regions the CPU runs up to N - 1 retired regions ahead.
+  //
+  // Only offsets are handed out, the buffer itself is the caller's. Fences creates and waits for
+  // the fences, GlFences in ChunkRenderer, a mock in bench_frame_ring:
+  //   Fence insert()          fence after every command submitted so far
+  //   bool signalled(Fence)   without blocking
+  //   void wait(Fence)        until it's signalled
+  //   void release(Fence)
+  template <typename Fences>
+  class FrameRing {
+  public:
+    using Fence = typename Fences::Fence;
+
+    FrameRing(std::size_t region_bytes, std::size_t regions, Fences fences = {})
+        : fences(std::move(fences)), regionBytes(region_bytes), pending(regions) {}
+    ~FrameRing() {
+      for (std::optional<Fence>& fence : pending)
+        if (fence)
+          fences.release(*fence);
+    }
+    FrameRing(const FrameRing&) = delete;
+    FrameRing& operator=(const FrameRing&) = delete;
+
+    // Offset into the whole buffer of `bytes` in the current region, aligned to `align` (a power
+    // of two). When the region hasn't got that much room left it's retired and the next one is
+    // used, once the GPU is done with it. nullopt if bytes is more than a region
+    std::optional<std::size_t> allocate(std::size_t bytes, std::size_t align = 1) {
+      if (bytes > regionBytes)
+        return std::nullopt;
+      std::size_t offset = (used + align - 1) & ~(align - 1);
+      if (acquired && offset + bytes > regionBytes)
+        retire();
+      if (!acquired) {
+        acquire();
+        offset = 0;
+      }
+      used = offset + bytes;
+      return current * regionBytes + offset;
+    }
+
+    // Fences the current region if anything was allocated from it, and moves on to the next.
+    // Called at the end of every frame, after the commands reading the region
+    void retire() {
+      if (!acquired)
+        return;
+      pending[current] = fences.insert();
+      current = (current + 1) % pending.size();
+      acquired = false;
+      used = 0;
+      stats.retired++;
+    }
+
+    std::size_t size() const noexcept { return regionBytes * pending.size(); }
+    std::size_t region() const noexcept { return current; }
+    FrameRingStats get_stats() const noexcept {
+      FrameRingStats result = stats;
+      result.regions = pending.size();
+      result.regionBytes = regionBytes;
+      return result;
+    }
+
+  private:
+    void acquire() {
+      if (std::optional<Fence>& fence = pending[current]) {
+        if (!fences.signalled(*fence)) {
+          stats.stalls++;
+          fences.wait(*fence);
+        }
+        fences.release(*fence);
+        fence.reset();
+      }
+      acquired = true;
+    }
+
+    Fences fences;
+    std::size_t regionBytes;
+    std::vector<std::optional<Fence>> pending; // per region, the fence it was retired with
+    std::size_t current = 0;
+    std::size_t used = 0;     // bytes of the current region handed out
+    bool acquired = false;    // the current region's fence has been waited for
+    FrameRingStats stats;
+  };
+}
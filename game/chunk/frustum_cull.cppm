@@ -0,0 +1,133 @@
+module;
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+export module frustum_cull;
+
+export {
+  // One frustum plane, normal . p + offset >= 0 on the inside
+  struct CullPlane {
+    float normal[3];
+    float offset;
+
+    bool operator==(const CullPlane&) const = default;
+  };
+  using CullPlanes = std::array<CullPlane, 6>;
+
+  // Axis-aligned boxes by column: min and max x / y / z in an array each, so the culling
+  // kernels load 8 boxes' worth of one coordinate at a time. Rows are swap-removed like the
+  // rows of whatever they're the bounds of.
+  class ChunkBounds {
+  public:
+    std::size_t size() const noexcept { return mins[0].size(); }
+
+    void push_back(const float (&min)[3], const float (&max)[3]) {
+      for (int axis = 0; axis < 3; axis++) {
+        mins[axis].push_back(min[axis]);
+        maxs[axis].push_back(max[axis]);
+      }
+    }
+
+    void clear() noexcept {
+      for (int axis = 0; axis < 3; axis++) {
+        mins[axis].clear();
+        maxs[axis].clear();
+      }
+    }
+
+    // The last row takes this one's place
+    void swap_remove(std::size_t row) noexcept {
+      for (int axis = 0; axis < 3; axis++) {
+        mins[axis][row] = mins[axis].back();
+        maxs[axis][row] = maxs[axis].back();
+        mins[axis].pop_back();
+        maxs[axis].pop_back();
+      }
+    }
+
+    const float* min(int axis) const noexcept { return mins[axis].data(); }
+    const float* max(int axis) const noexcept { return maxs[axis].data(); }
+
+  private:
+    std::vector<float> mins[3];
+    std::vector<float> maxs[3];
+  };
+
+  // Words of a visibility mask over `rows` boxes, bit (row % 64) of word (row / 64)
+  constexpr std::size_t cull_mask_words(std::size_t rows) noexcept { return (rows + 63) / 64; }
+
+  // A box is visible unless it's entirely outside one of the planes: the corner furthest
+  // along the plane's normal is tested, as ChunkManager::isAABBInsideFrustum() does
+  inline void cull_bounds_scalar(const ChunkBounds& bounds, const CullPlanes& planes, std::uint64_t* visible,
+      std::size_t begin = 0) {
+    const std::size_t rows = bounds.size();
+    for (std::size_t row = begin; row < rows; row++) {
+      bool inside = true;
+      for (const CullPlane& plane : planes) {
+        const float x = (plane.normal[0] >= 0 ? bounds.max(0) : bounds.min(0))[row];
+        const float y = (plane.normal[1] >= 0 ? bounds.max(1) : bounds.min(1))[row];
+        const float z = (plane.normal[2] >= 0 ? bounds.max(2) : bounds.min(2))[row];
+        const float distance = plane.normal[0] * x + plane.normal[1] * y + plane.normal[2] * z + plane.offset;
+        if (distance < 0) {
+          inside = false;
+          break;
+        }
+      }
+      const std::uint64_t bit = std::uint64_t(1) << (row % 64);
+      visible[row / 64] = inside ? visible[row / 64] | bit : visible[row / 64] & ~bit;
+    }
+  }
+
+#if (defined(__x86_64__) || defined(_M_X64)) && (defined(__GNUC__) || defined(__clang__))
+  // 8 boxes per iteration against all six planes, the tail on the scalar code. Same
+  // arithmetic in the same order as the scalar code (no FMA), so the masks are identical
+  __attribute__((target("avx2"))) inline void cull_bounds_avx2(const ChunkBounds& bounds, const CullPlanes& planes,
+      std::uint64_t* visible) {
+    // The corner each plane tests doesn't depend on the box: pick its columns once
+    const float* corner[6][3];
+    __m256 normal[6][3], offset[6];
+    for (int p = 0; p < 6; p++) {
+      for (int axis = 0; axis < 3; axis++) {
+        corner[p][axis] = planes[p].normal[axis] >= 0 ? bounds.max(axis) : bounds.min(axis);
+        normal[p][axis] = _mm256_set1_ps(planes[p].normal[axis]);
+      }
+      offset[p] = _mm256_set1_ps(planes[p].offset);
+    }
+
+    const std::size_t rows = bounds.size();
+    const std::size_t batched = rows & ~std::size_t(7);
+    const __m256 zero = _mm256_setzero_ps();
+    for (std::size_t row = 0; row < batched; row += 8) {
+      __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+      for (int p = 0; p < 6; p++) {
+        const __m256 x = _mm256_mul_ps(normal[p][0], _mm256_loadu_ps(corner[p][0] + row));
+        const __m256 y = _mm256_mul_ps(normal[p][1], _mm256_loadu_ps(corner[p][1] + row));
+        const __m256 z = _mm256_mul_ps(normal[p][2], _mm256_loadu_ps(corner[p][2] + row));
+        const __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(x, y), z), offset[p]);
+        // Not less than zero, a NaN distance counts as inside like in the scalar code
+        inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, zero, _CMP_NLT_UQ));
+      }
+      const std::uint64_t bits = static_cast<std::uint64_t>(_mm256_movemask_ps(inside));
+      const unsigned shift = row % 64;
+      visible[row / 64] = (visible[row / 64] & ~(std::uint64_t(0xff) << shift)) | bits << shift;
+    }
+    cull_bounds_scalar(bounds, planes, visible, batched);
+  }
+#endif
+
+  // Sets bit `row` of visible (cull_mask_words(bounds.size()) words) for every box that can
+  // be in the frustum and clears the rest, on the widest kernel the CPU supports. Bits past
+  // the last box are left as they were
+  inline void cull_bounds(const ChunkBounds& bounds, const CullPlanes& planes, std::uint64_t* visible) {
+#if (defined(__x86_64__) || defined(_M_X64)) && (defined(__GNUC__) || defined(__clang__))
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    if (avx2)
+      return cull_bounds_avx2(bounds, planes, visible);
+#endif
+    cull_bounds_scalar(bounds, planes, visible);
+  }
+}
@@ -0,0 +1,195 @@
+module;
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+export module lod;
+
+import mesher;
+
+export {
+  constexpr int MAX_LOD = 3; // 8x
+  // What downsample() fills buried cells with, Block::blocks::STONE (lod doesn't import chunk,
+  // chunk_manager checks the two agree)
+  constexpr std::uint8_t LOD_BURIED_TYPE = 3;
+
+  // Outer radius, in chunks, of the LOD 0 (full detail), 1 (2x) and 2 (4x) rings; past the last is LOD 3 (8x).
+  // A chunk only changes level once it's `hysteresis` chunks past a ring, so one walking along
+  // a boundary doesn't remesh back and forth
+  struct LodSettings {
+    float rings[MAX_LOD] = { 8.0f, 14.0f, 22.0f };
+    float hysteresis = 1.0f;
+  };
+
+  constexpr int lod_factor(int lod) noexcept { return 1 << lod; }
+
+  // Level for a chunk at `distance` chunks that has none yet
+  int lod_for_distance(const LodSettings& settings, float distance) noexcept {
+    int lod = 0;
+    while (lod < MAX_LOD && distance > settings.rings[lod])
+      lod++;
+    return lod;
+  }
+
+  // Level for a chunk currently at `current`, with hysteresis on both sides of its ring
+  int select_lod(const LodSettings& settings, int current, float distance) noexcept {
+    int lod = current;
+    while (lod < MAX_LOD && distance > settings.rings[lod] + settings.hysteresis)
+      lod++;
+    while (lod > 0 && distance < settings.rings[lod - 1] - settings.hysteresis)
+      lod--;
+    return lod;
+  }
+
+  // Downsamples the interior of a padded chunk by `factor` into another padded grid: coarse cell
+  // (x, y, z) lands at padded (x + 1, y + 1, z + 1), everything else is air. CS isn't a multiple
+  // of 4 or 8, so the last cell on each axis covers fewer voxels.
+  //
+  // A cell is solid if at least half of its voxels are (majority), and takes the type of the
+  // topmost solid voxel in it, so grass stays on top of the far hills. Cells buried between
+  // six solid ones never show a face, so they skip that search and are LOD_BURIED_TYPE.
+  // The padding stays air on purpose: every LOD chunk draws its boundary faces (skirts). They
+  // close the seam where its coarse surface is above a neighbour's, not where it's below: the
+  // neighbour's side faces there were culled against voxels the coarse mesh doesn't have, so
+  // the step is open, seen from this chunk's side. Facing away from the finer, nearer chunk,
+  // it rarely faces the camera.
+  void downsample(const std::uint8_t* voxels, const std::uint64_t* opaqueMask, int factor,
+      std::uint8_t* outVoxels, std::uint64_t* outOpaqueMask) noexcept {
+    std::memset(outVoxels, 0, CS_P3);
+    std::memset(outOpaqueMask, 0, CS_P2 * sizeof(std::uint64_t));
+
+    const int cells = (CS + factor - 1) / factor;
+    const auto range = [factor](int c, int& begin, int& end) {
+      begin = 1 + c * factor;
+      end = std::min(begin + factor, CS + 1);
+    };
+    // Alternating runs of `factor` ones and zeros, the even cells of a row
+    std::uint64_t evenCells = 0;
+    for (int z = 0; z < 64; z += 2 * factor)
+      evenCells |= ((1ull << factor) - 1) << z;
+
+    for (int cy = 0; cy < cells; cy++) {
+      int y0, y1;
+      range(cy, y0, y1);
+      for (int cx = 0; cx < cells; cx++) {
+        int x0, x1;
+        range(cx, x0, x1);
+
+        // Solid voxels per cell, summed over the cell's rows without leaving the register:
+        // the row's bits are counted within factor-wide fields, which then get split into
+        // even and odd cells so each count has 2x factor bits to grow into (up to factor^3)
+        std::uint64_t evenSum = 0, oddSum = 0;
+        for (int y = y0; y < y1; y++) {
+          for (int x = x0; x < x1; x++) {
+            std::uint64_t c = opaqueMask[(y * CS_P) + x] >> 1 & ((1ull << CS) - 1);
+            c -= c >> 1 & 0x5555555555555555ull;
+            if (factor >= 4)
+              c = (c & 0x3333333333333333ull) + (c >> 2 & 0x3333333333333333ull);
+            if (factor >= 8)
+              c = (c + (c >> 4)) & 0x0f0f0f0f0f0f0f0full;
+            evenSum += c & evenCells;
+            oddSum += c >> factor & evenCells;
+          }
+        }
+        if (!(evenSum | oddSum))
+          continue;
+
+        const int area = (y1 - y0) * (x1 - x0);
+        std::uint64_t row = 0;
+        for (int cz = 0; cz < cells; cz++) {
+          const std::uint64_t sum = cz & 1 ? oddSum : evenSum;
+          const int solid = static_cast<int>(sum >> ((cz & ~1) * factor) & ((1ull << (2 * factor)) - 1));
+          const int volume = area * (std::min(factor, CS - cz * factor));
+          row |= std::uint64_t(solid * 2 >= volume) << (cz + 1);
+        }
+        outOpaqueMask[((cy + 1) * CS_P) + (cx + 1)] = row;
+      }
+    }
+
+    for (int cy = 0; cy < cells; cy++) {
+      int y0, y1;
+      range(cy, y0, y1);
+      for (int cx = 0; cx < cells; cx++) {
+        const int i = ((cy + 1) * CS_P) + (cx + 1);
+        const std::uint64_t row = outOpaqueMask[i];
+        if (!row)
+          continue;
+        const std::uint64_t buried = row & (row << 1) & (row >> 1) &
+          outOpaqueMask[i + CS_P] & outOpaqueMask[i - CS_P] & outOpaqueMask[i + 1] & outOpaqueMask[i - 1];
+
+        int x0, x1;
+        range(cx, x0, x1);
+        std::uint8_t* out = &outVoxels[i * CS_P];
+        for (std::uint64_t m = row; m; m &= m - 1) {
+          const int pz = std::countr_zero(m);
+          if (buried >> pz & 1) {
+            out[pz] = LOD_BURIED_TYPE;
+            continue;
+          }
+
+          int z0, z1;
+          range(pz - 1, z0, z1);
+          const std::uint64_t zBits = ((1ull << (z1 - z0)) - 1) << z0;
+          std::uint8_t type = 0;
+          for (int y = y1 - 1; y >= y0 && !type; y--) {
+            for (int x = x0; x < x1; x++) {
+              if (const std::uint64_t bits = opaqueMask[(y * CS_P) + x] & zBits) {
+                type = voxels[std::countr_zero(bits) + (x * CS_P) + (y * CS_P2)];
+                break;
+              }
+            }
+          }
+          out[pz] = type;
+        }
+      }
+    }
+  }
+
+  // Rescales quads meshed from a downsample()d grid back to voxel units, clipping the last
+  // cell on each axis at CS. The result draws with the same shader and chunk offset as a
+  // full-detail mesh; see main.vs for which corner each face's position is.
+  void scale_quads(std::uint64_t* quads, const int* faceBegin, const int* faceLength, int factor) noexcept {
+    constexpr int FLIP[6] = { 1, -1, -1, 1, -1, 1 };
+    const auto scale = [factor](int v) { return std::min(v * factor, CS); };
+
+    for (int face = 0; face < 6; face++) {
+      const int wAxis = (face & 2) >> 1, hAxis = 2 - (face >> 2);
+      const int planeAxis = 3 - wAxis - hAxis;
+
+      for (int i = faceBegin[face]; i < faceBegin[face] + faceLength[face]; i++) {
+        const std::uint64_t quad = quads[i];
+        int pos[3] = { int(quad & 63), int(quad >> 6 & 63), int(quad >> 12 & 63) };
+        int w = int(quad >> 18 & 63), h = int(quad >> 24 & 63);
+
+        if (FLIP[face] > 0) {
+          const int start = pos[wAxis];
+          pos[wAxis] = scale(start);
+          w = scale(start + w) - pos[wAxis];
+        } else {
+          const int end = pos[wAxis];
+          pos[wAxis] = scale(end);
+          w = pos[wAxis] - scale(end - w);
+        }
+        const int hStart = pos[hAxis];
+        pos[hAxis] = scale(hStart);
+        h = scale(hStart + h) - pos[hAxis];
+        pos[planeAxis] = scale(pos[planeAxis]);
+
+        quads[i] = (quad & ~0x3fffffffull) | (std::uint64_t(h) << 24) | (std::uint64_t(w) << 18) |
+          (std::uint64_t(pos[2]) << 12) | (std::uint64_t(pos[1]) << 6) | std::uint64_t(pos[0]);
+      }
+    }
+  }
+
+  // mesh() at `lod`, through a caller-provided scratch grid for the downsampled voxels
+  void mesh_lod(const std::uint8_t* voxels, const std::uint64_t* opaqueMask, int lod, MeshArena& arena,
+      std::uint8_t* scratchVoxels, std::uint64_t* scratchOpaqueMask) noexcept {
+    if (lod == 0) {
+      mesh(voxels, opaqueMask, arena.data());
+      return;
+    }
+    downsample(voxels, opaqueMask, lod_factor(lod), scratchVoxels, scratchOpaqueMask);
+    mesh(scratchVoxels, scratchOpaqueMask, arena.data());
+    scale_quads(arena.data().vertices, arena.data().faceVertexBegin, arena.data().faceVertexLength, lod_factor(lod));
+  }
+}
@@ -0,0 +1,198 @@
+module;
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+export module mesh_cache;
+
+import mesher;
+import chunk_renderer;
+
+export {
+  // 64-bit hash of what mesh() reads from a padded grid: the interior and the six face slabs.
+  // Edge and corner padding is left out, the generator fills it and the padding assembler
+  // doesn't. `seed` tells apart inputs meshed differently (the level of detail).
+  std::uint64_t mesh_input_hash(const std::uint8_t* voxels, std::uint64_t seed) noexcept {
+    constexpr std::uint64_t K0 = 0x9e3779b97f4a7c15ull, K1 = 0xc2b2ae3d27d4eb4full;
+    // One independent lane per word of a z row, so the multiplies don't wait on each other
+    constexpr int LANES = CS_P / 8;
+    std::uint64_t lanes[LANES];
+    for (int i = 0; i < LANES; i++)
+      lanes[i] = seed + K1 * (i + 1);
+    const auto row = [&lanes](const std::uint8_t* bytes) {
+      std::uint64_t words[LANES];
+      std::memcpy(words, bytes, sizeof(words));
+      for (int i = 0; i < LANES; i++)
+        lanes[i] = std::rotl(lanes[i] ^ words[i], 29) * K0;
+    };
+
+    // x and y face slab rows go through a copy without their two edge voxels
+    std::uint8_t slab[CS_P] = {};
+    const auto slabRow = [&row, &slab](const std::uint8_t* bytes) {
+      std::memcpy(slab + 1, bytes + 1, CS);
+      row(slab);
+    };
+    for (int x = 1; x <= CS; x++)
+      slabRow(voxels + (x * CS_P));
+    for (int y = 1; y <= CS; y++) {
+      const std::uint8_t* layer = voxels + (y * CS_P2);
+      slabRow(layer);
+      for (int x = 1; x <= CS; x++)
+        row(layer + (x * CS_P));
+      slabRow(layer + ((CS_P - 1) * CS_P));
+    }
+    for (int x = 1; x <= CS; x++)
+      slabRow(voxels + (x * CS_P) + ((CS_P - 1) * CS_P2));
+
+    std::uint64_t h = seed;
+    for (std::uint64_t lane : lanes) {
+      h = (h ^ lane) * K0;
+      h ^= h >> 29;
+    }
+    h *= K1;
+    return h ^ (h >> 32);
+  }
+
+  struct MeshCacheStats {
+    std::size_t lookups = 0;  // find() calls, on the workers and the main thread
+    std::size_t hits = 0;     // ... that skipped mesh()
+    std::size_t shares = 0;   // uploads that reused the buffer space of an identical mesh
+    std::size_t evictions = 0;
+    std::size_t entries = 0;
+    std::size_t bytes = 0;    // quads held on the CPU side
+  };
+
+  // Meshes keyed by mesh_input_hash() of their input, least recently used first out past
+  // `budget_bytes` of quads. Any thread may find() and insert(); the buffer space an entry
+  // points at (its draw commands) is main thread only, and so is collect().
+  //
+  // Keys are trusted as they are: a 64-bit collision would draw another chunk's mesh.
+  class MeshCache {
+  public:
+    explicit MeshCache(std::size_t budget_bytes) : budget(budget_bytes) {}
+
+    // Copies a cached mesh into `out` the way mesh() would have left it
+    bool find(std::uint64_t key, MeshData& out) {
+      std::scoped_lock lock(mutex);
+      stats.lookups++;
+      auto it = index.find(key);
+      if (it == index.end())
+        return false;
+      lru.splice(lru.begin(), lru, it->second);
+
+      const Entry& entry = *it->second;
+      std::memcpy(out.vertices, entry.quads.data(), entry.quads.size() * sizeof(std::uint64_t));
+      std::memcpy(out.faceVertexBegin, entry.faceBegin, sizeof(entry.faceBegin));
+      std::memcpy(out.faceVertexLength, entry.faceLength, sizeof(entry.faceLength));
+      out.vertexCount = static_cast<int>(entry.quads.size()) + 1;
+      stats.hits++;
+      return true;
+    }
+
+    // No-op if the key is there already
+    void insert(std::uint64_t key, const MeshData& mesh) {
+      const int quadCount = mesh.vertexCount > 0 ? mesh.vertexCount - 1 : 0;
+      const std::size_t bytes = quadCount * sizeof(std::uint64_t);
+      if (bytes > budget)
+        return;
+
+      std::scoped_lock lock(mutex);
+      if (index.contains(key))
+        return;
+      Entry& entry = lru.emplace_front();
+      entry.key = key;
+      entry.quads.assign(mesh.vertices, mesh.vertices + quadCount);
+      std::memcpy(entry.faceBegin, mesh.faceVertexBegin, sizeof(entry.faceBegin));
+      std::memcpy(entry.faceLength, mesh.faceVertexLength, sizeof(entry.faceLength));
+      index.emplace(key, lru.begin());
+      stats.bytes += bytes;
+
+      while (stats.bytes > budget) {
+        Entry& last = lru.back();
+        stats.bytes -= last.quads.size() * sizeof(std::uint64_t);
+        stats.evictions++;
+        if (last.uploaded)
+          retired.push_back(last.commands);
+        index.erase(last.key);
+        lru.pop_back();
+      }
+      stats.entries = index.size();
+    }
+
+    // Main thread: the draw commands of an uploaded copy of the mesh, with whatever
+    // baseInstance the chunk that uploaded it had
+    std::optional<std::array<DrawArraysIndirectCommand, 6>> uploaded(std::uint64_t key) {
+      std::scoped_lock lock(mutex);
+      auto it = index.find(key);
+      if (it == index.end() || !it->second->uploaded)
+        return std::nullopt;
+      stats.shares++;
+      return it->second->commands;
+    }
+
+    // Main thread: remembers where the mesh was uploaded. True if the entry took the
+    // commands, and so holds a reference on their buffer space until it's collect()ed
+    bool attach(std::uint64_t key, const std::array<DrawArraysIndirectCommand, 6>& commands) {
+      std::scoped_lock lock(mutex);
+      auto it = index.find(key);
+      if (it == index.end() || it->second->uploaded)
+        return false;
+      it->second->commands = commands;
+      it->second->uploaded = true;
+      return true;
+    }
+
+    // Main thread: hands the draw commands of evicted entries to release(commands)
+    template <typename Release>
+    void collect(Release&& release) {
+      std::vector<std::array<DrawArraysIndirectCommand, 6>> evicted;
+      {
+        std::scoped_lock lock(mutex);
+        evicted.swap(retired);
+      }
+      for (const auto& commands : evicted)
+        release(commands);
+    }
+
+    // Main thread: passes every draw command the cache holds, uploaded or evicted, to
+    // relocate(command) to rewrite, after their buffer space moved
+    template <typename Relocate>
+    void relocate(Relocate&& relocate) {
+      std::scoped_lock lock(mutex);
+      for (Entry& entry : lru)
+        if (entry.uploaded)
+          for (DrawArraysIndirectCommand& command : entry.commands)
+            relocate(command);
+      for (auto& commands : retired)
+        for (DrawArraysIndirectCommand& command : commands)
+          relocate(command);
+    }
+
+    MeshCacheStats get_stats() const {
+      std::scoped_lock lock(mutex);
+      return stats;
+    }
+
+  private:
+    struct Entry {
+      std::uint64_t key = 0;
+      std::vector<std::uint64_t> quads;
+      int faceBegin[6] = {};
+      int faceLength[6] = {};
+      std::array<DrawArraysIndirectCommand, 6> commands{};
+      bool uploaded = false;
+    };
+
+    mutable std::mutex mutex;
+    std::size_t budget;
+    std::list<Entry> lru; // most recently used first
+    std::unordered_map<std::uint64_t, std::list<Entry>::iterator> index;
+    std::vector<std::array<DrawArraysIndirectCommand, 6>> retired;
+    MeshCacheStats stats;
+  };
+}
@@ -34,18 +34,32 @@ SOFTWARE.
 //   * Define BM_VECTOR with your own vector implementation - otherwise it will use std::vector
 
 module;
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
+#include <type_traits>
 #include <vector>
 #include <cstring>
+#include <memory>
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 export module mesher;
 
 #ifndef BM_VECTOR
 #define BM_VECTOR std::vector
 #endif
 
+#ifndef BM_MEMSET
+#define BM_MEMSET std::memset
+#endif
+
 
 export {
-// CS = chunk size (max 62)
+// CS = chunk size the game meshes (max 62). The mesher itself is a template over the chunk
+// size (Mesher<Size> below); everything without a size parameter is for this one.
 constexpr int CS = 62;
 
 // Padded chunk size
@@ -54,44 +68,136 @@ constexpr int CS_2 = CS * CS;
 constexpr int CS_P2 = CS_P * CS_P;
 constexpr int CS_P3 = CS_P * CS_P * CS_P;
 
-struct MeshData {
-  uint64_t* faceMasks = nullptr; // CS_2 * 6
-  uint64_t* opaqueMask = nullptr; //CS_P2
-  uint8_t* forwardMerged = nullptr; // CS_2
-  uint8_t* rightMerged = nullptr; // CS
-  BM_VECTOR<uint64_t>* vertices = nullptr;
+// Most quads a chunk can produce: a face needs a solid voxel with air in front of it, so at
+// most every other voxel of a column (CS / 2) shows one per direction, and greedy merging
+// never emits more quads than visible faces. A 3D checkerboard hits this exactly.
+constexpr int MAX_QUADS = 6 * CS_2 * (CS / 2);
+
+// One bit per padded voxel of a column: chunks up to 30 fit their columns in 32 bits
+template <int Size>
+using MeshMask = std::conditional_t<(Size + 2 <= 32), uint32_t, uint64_t>;
+
+template <int Size>
+struct BasicMeshData {
+  MeshMask<Size>* faceMasks = nullptr; // CS_2 * 6
+  MeshMask<Size>* opaqueMask = nullptr; //CS_P2
+  uint8_t* forwardMerged = nullptr; // CS_2, zeroed
+  uint8_t* rightMerged = nullptr; // CS, zeroed
+  uint64_t* vertices = nullptr; // MAX_QUADS, so there's never a capacity check
+  uint64_t* spareVertices = nullptr; // MAX_QUADS, remesh() builds into it and swaps it with vertices
   int vertexCount = 0;
-  int maxVertices = 0;
   int faceVertexBegin[6] = { 0 };
   int faceVertexLength[6] = { 0 };
 };
 
+using MeshData = BasicMeshData<CS>;
+
+// Greedy mesher for a Size^3 chunk in a (Size + 2)^3 padded grid. Sizes, loop bounds and the
+// mask width are compile-time constants of the instantiation, so 16, 30 and 62 each get
+// their own code; the free functions below pick the instantiation from the MeshData.
+template <int Size>
+struct Mesher {
+  static_assert(Size >= 2 && Size <= 62, "a padded column has to fit in 64 bits");
+
+  static constexpr int CS = Size;
+  static constexpr int CS_P = CS + 2;
+  static constexpr int CS_2 = CS * CS;
+  static constexpr int CS_P2 = CS_P * CS_P;
+  static constexpr int CS_P3 = CS_P * CS_P * CS_P;
+  static constexpr int MAX_QUADS = 6 * CS_2 * ((CS + 1) / 2);
+
+  using Mask = MeshMask<Size>;
+  // Interior bits of a padded column
+  static constexpr Mask P_MASK = ((Mask(1) << (CS_P - 1)) - 1) & ~Mask(1);
+
+  static int getAxisIndex(const int axis, const int a, const int b, const int c) {
+    if (axis == 0) return b + (a * CS_P) + (c * CS_P2);
+    else if (axis == 1) return b + (c * CS_P) + (a * CS_P2);
+    else return c + (a * CS_P) + (b * CS_P2);
+  }
+
+  static void cullColumn(const Mask* opaqueMask, Mask* faceMasks, const int a, const int b);
+  static void cullFacesScalar(const Mask* opaqueMask, Mask* faceMasks);
+  static void buildOpaqueMaskScalar(const uint8_t* voxels, Mask* opaqueMask);
+  static void meshLayer(const uint8_t* voxels, BasicMeshData<Size>& meshData, const int face, const int layer, int& vertexI);
+  static void meshZFaces(const uint8_t* voxels, BasicMeshData<Size>& meshData, const int face, const Mask bitFilter, int& vertexI);
+  static void mesh(const uint8_t* voxels, const Mask* opaqueMask, BasicMeshData<Size>& meshData);
+  static int remesh(const uint8_t* voxels, const Mask* opaqueMask, BasicMeshData<Size>& meshData, const int x, const int y, const int z);
+};
+
+// All of mesh()'s buffers in one allocation, reused from one mesh() call to the next.
+// The quads are mesh() output that callers read straight from data().vertices; untouched
+// pages of the worst-case quad area are never written, so they cost address space only.
+// There are two quad areas, remesh() swaps them, so only arenas that are remeshed touch the
+// second.
+template <int Size>
+class BasicMeshArena {
+public:
+  BasicMeshArena()
+    : memory(new std::byte[FACE_MASK_BYTES + MERGED_BYTES + 2 * Mesher<Size>::MAX_QUADS * sizeof(uint64_t)]) {
+    meshData.faceMasks = reinterpret_cast<MeshMask<Size>*>(memory.get());
+    meshData.forwardMerged = reinterpret_cast<uint8_t*>(memory.get() + FACE_MASK_BYTES);
+    meshData.rightMerged = meshData.forwardMerged + Mesher<Size>::CS_2;
+    meshData.vertices = reinterpret_cast<uint64_t*>(memory.get() + FACE_MASK_BYTES + MERGED_BYTES);
+    meshData.spareVertices = meshData.vertices + Mesher<Size>::MAX_QUADS;
+    BM_MEMSET(meshData.forwardMerged, 0, Mesher<Size>::CS_2 + Mesher<Size>::CS);
+  }
+
+  BasicMeshArena(const BasicMeshArena&) = delete;
+  BasicMeshArena& operator=(const BasicMeshArena&) = delete;
+
+  BasicMeshData<Size>& data() { return meshData; }
+  const BasicMeshData<Size>& data() const { return meshData; }
+
+  // The last mesh()'s quads, face f at quads() + data().faceVertexBegin[f]
+  const uint64_t* quads() const { return meshData.vertices; }
+  int quadCount() const { return meshData.vertexCount > 0 ? meshData.vertexCount - 1 : 0; }
+
+private:
+  // Both rounded up to 8 bytes, so the quads after them stay aligned
+  static constexpr std::size_t FACE_MASK_BYTES = (Mesher<Size>::CS_2 * 6 * sizeof(MeshMask<Size>) + 7) & ~std::size_t(7);
+  static constexpr std::size_t MERGED_BYTES = (Mesher<Size>::CS_2 + Mesher<Size>::CS + 7) & ~std::size_t(7);
+
+  std::unique_ptr<std::byte[]> memory;
+  BasicMeshData<Size> meshData;
+};
+
+using MeshArena = BasicMeshArena<CS>;
+
 // @param[in] voxels: The input data includes duplicate edge data from neighboring chunks which is used
 // for visibility culling. For optimal performance, your world data should already be structured
 // this way so that you can feed the data straight into this algorithm.
-// Input data is ordered in ZXY and is 64^3 which results in a 62^3 mesh.
+// Input data is ordered in ZXY and is 64^3 which results in a 62^3 mesh (or (Size + 2)^3 and Size^3).
 //
 // @param[out] meshData The allocated vertices in MeshData with a length of meshData.vertexCount.
-void mesh(const uint8_t* voxels, MeshData& meshData);
+template <int Size>
+void mesh(const uint8_t* voxels, BasicMeshData<Size>& meshData) {
+  Mesher<Size>::mesh(voxels, meshData.opaqueMask, meshData);
+}
 
+// Same as above, but reads the opaque column masks from opaqueMask instead of meshData.opaqueMask,
+// so a chunk that keeps its own padded voxels and masks (Chunk in Padded storage) is meshed in place.
+template <int Size>
+void mesh(const uint8_t* voxels, const MeshMask<Size>* opaqueMask, BasicMeshData<Size>& meshData) {
+  Mesher<Size>::mesh(voxels, opaqueMask, meshData);
+}
 
+// Incremental version of mesh() for a single voxel edit at interior coordinates (x, y, z), which may
+// be -1 or CS for an edit that landed in the padding. meshData must still hold this chunk's previous
+// result (faceMasks and vertices) and have spareVertices. Only the 5 affected columns are re-culled and
+// only the (at most 3) affected layers per face are re-meshed; the other quads are kept as they are.
+// The new quads are built in spareVertices, which then swaps with vertices: nothing is allocated.
+//
+// @return A bitmask of the faces whose quads changed and need to be re-uploaded.
+template <int Size>
+int remesh(const uint8_t* voxels, const MeshMask<Size>* opaqueMask, BasicMeshData<Size>& meshData, const int x, const int y, const int z) {
+  return Mesher<Size>::remesh(voxels, opaqueMask, meshData, x, y, z);
+}
 
-#ifndef BM_MEMSET
-#define BM_MEMSET std::memset
-#endif
 
-inline const int getAxisIndex(const int axis, const int a, const int b, const int c) {
-  if (axis == 0) return b + (a * CS_P) + (c * CS_P2);
-  else if (axis == 1) return b + (c * CS_P) + (a * CS_P2);
-  else return c + (a * CS_P) + (b * CS_P2);
-}
 
-inline const void insertQuad(BM_VECTOR<uint64_t>& vertices, uint64_t quad, int& vertexI, int& maxVertices) {
-  if (vertexI >= maxVertices - 6) {
-    vertices.resize(maxVertices * 2, 0);
-    maxVertices *= 2;
-  }
 
+inline const void insertQuad(uint64_t* vertices, uint64_t quad, int& vertexI) {
   vertices[vertexI] = quad;
 
   vertexI++;
@@ -101,103 +207,341 @@ inline const uint64_t getQuad(uint64_t x, uint64_t y, uint64_t z, uint64_t w, ui
   return (type << 32) | (h << 24) | (w << 18) | (z << 12) | (y << 6) | x;
 }
 
-constexpr uint64_t P_MASK = ~(1ull << 63 | 1);
+constexpr uint64_t P_MASK = Mesher<CS>::P_MASK;
 
-void mesh(const uint8_t* voxels, MeshData& meshData) {
-  meshData.vertexCount = 0;
-  int vertexI = 0;
+// Hidden face culling for the padded column at (a, b), both in [1, CS]
+template <int Size>
+void Mesher<Size>::cullColumn(const Mask* opaqueMask, Mask* faceMasks, const int a, const int b) {
+  const int aCS_P = a * CS_P;
+  const Mask columnBits = opaqueMask[aCS_P + b] & P_MASK;
+  const int baIndex = (b - 1) + (a - 1) * CS;
+  const int abIndex = (a - 1) + (b - 1) * CS;
 
-  uint64_t* opaqueMask = meshData.opaqueMask;
-  uint64_t* faceMasks = meshData.faceMasks;
-  uint8_t* forwardMerged = meshData.forwardMerged;
-  uint8_t* rightMerged = meshData.rightMerged;
+  faceMasks[baIndex + 0 * CS_2] = (columnBits & ~opaqueMask[aCS_P + CS_P + b]) >> 1;
+  faceMasks[baIndex + 1 * CS_2] = (columnBits & ~opaqueMask[aCS_P - CS_P + b]) >> 1;
 
-  // Hidden face culling
-  for (int a = 1; a < CS_P - 1; a++) {
-    const int aCS_P = a * CS_P;
+  faceMasks[abIndex + 2 * CS_2] = (columnBits & ~opaqueMask[aCS_P + (b + 1)]) >> 1;
+  faceMasks[abIndex + 3 * CS_2] = (columnBits & ~opaqueMask[aCS_P + (b - 1)]) >> 1;
+
+  faceMasks[baIndex + 4 * CS_2] = columnBits & ~(opaqueMask[aCS_P + b] >> 1);
+  faceMasks[baIndex + 5 * CS_2] = columnBits & Mask(~(opaqueMask[aCS_P + b] << 1));
+}
 
+// Which kernels cullFaces() / buildOpaqueMask() run on this machine
+enum class MesherSimd { Scalar, AVX2, NEON };
+
+inline MesherSimd mesherSimd() {
+#if (defined(__x86_64__) || defined(_M_X64)) && (defined(__GNUC__) || defined(__clang__))
+  static const bool avx2 = __builtin_cpu_supports("avx2");
+  return avx2 ? MesherSimd::AVX2 : MesherSimd::Scalar;
+#elif defined(__ARM_NEON)
+  return MesherSimd::NEON;
+#else
+  return MesherSimd::Scalar;
+#endif
+}
+
+// Hidden face culling for every interior column, one column at a time
+template <int Size>
+void Mesher<Size>::cullFacesScalar(const Mask* opaqueMask, Mask* faceMasks) {
+  for (int a = 1; a < CS_P - 1; a++) {
     for (int b = 1; b < CS_P - 1; b++) {
-      const uint64_t columnBits = opaqueMask[(a * CS_P) + b] & P_MASK;
-      const int baIndex = (b - 1) + (a - 1) * CS;
-      const int abIndex = (a - 1) + (b - 1) * CS;
+      cullColumn(opaqueMask, faceMasks, a, b);
+    }
+  }
+}
 
-      faceMasks[baIndex + 0 * CS_2] = (columnBits & ~opaqueMask[aCS_P + CS_P + b]) >> 1;
-      faceMasks[baIndex + 1 * CS_2] = (columnBits & ~opaqueMask[aCS_P - CS_P + b]) >> 1;
+// opaqueMask[(y * CS_P) + x] bit z = voxel (x, y, z) isn't air, for the whole padded grid
+template <int Size>
+void Mesher<Size>::buildOpaqueMaskScalar(const uint8_t* voxels, Mask* opaqueMask) {
+  for (int row = 0; row < CS_P2; row++) {
+    const uint8_t* v = voxels + row * CS_P;
+    Mask bits = 0;
+    for (int z = 0; z < CS_P; z++)
+      bits |= Mask(v[z] != 0) << z;
+    opaqueMask[row] = bits;
+  }
+}
+
+template <int Size = CS>
+inline void cullFacesScalar(const MeshMask<Size>* opaqueMask, MeshMask<Size>* faceMasks) {
+  Mesher<Size>::cullFacesScalar(opaqueMask, faceMasks);
+}
 
-      faceMasks[abIndex + 2 * CS_2] = (columnBits & ~opaqueMask[aCS_P + (b + 1)]) >> 1;
-      faceMasks[abIndex + 3 * CS_2] = (columnBits & ~opaqueMask[aCS_P + (b - 1)]) >> 1;
+template <int Size = CS>
+inline void buildOpaqueMaskScalar(const uint8_t* voxels, MeshMask<Size>* opaqueMask) {
+  Mesher<Size>::buildOpaqueMaskScalar(voxels, opaqueMask);
+}
 
-      faceMasks[baIndex + 4 * CS_2] = columnBits & ~(opaqueMask[aCS_P + b] >> 1);
-      faceMasks[baIndex + 5 * CS_2] = columnBits & ~(opaqueMask[aCS_P + b] << 1);
+// The SIMD kernels are written for 64-bit columns of the game's chunk size (CS); other sizes
+// run the scalar ones
+#if (defined(__x86_64__) || defined(_M_X64)) && (defined(__GNUC__) || defined(__clang__))
+// 4 columns per instruction. Faces 0, 1, 4 and 5 are stored [b + a * CS], contiguous in b,
+// faces 2 and 3 are [a + b * CS] and get scattered lane by lane
+__attribute__((target("avx2"))) inline void cullFacesAVX2(const uint64_t* opaqueMask, uint64_t* faceMasks) {
+  const __m256i pMask = _mm256_set1_epi64x(static_cast<long long>(P_MASK));
+  for (int a = 1; a < CS_P - 1; a++) {
+    const uint64_t* row = opaqueMask + a * CS_P;
+    int b = 1;
+    for (; b + 4 <= CS_P - 1; b += 4) {
+      const __m256i here = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + b));
+      const __m256i columnBits = _mm256_and_si256(here, pMask);
+      const __m256i up = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + CS_P + b));
+      const __m256i down = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row - CS_P + b));
+      const __m256i right = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + b + 1));
+      const __m256i left = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + b - 1));
+
+      uint64_t* ba = faceMasks + (b - 1) + (a - 1) * CS;
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(ba + 0 * CS_2), _mm256_srli_epi64(_mm256_andnot_si256(up, columnBits), 1));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(ba + 1 * CS_2), _mm256_srli_epi64(_mm256_andnot_si256(down, columnBits), 1));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(ba + 4 * CS_2), _mm256_andnot_si256(_mm256_srli_epi64(here, 1), columnBits));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(ba + 5 * CS_2), _mm256_andnot_si256(_mm256_slli_epi64(here, 1), columnBits));
+
+      alignas(32) uint64_t f2[4], f3[4];
+      _mm256_store_si256(reinterpret_cast<__m256i*>(f2), _mm256_srli_epi64(_mm256_andnot_si256(right, columnBits), 1));
+      _mm256_store_si256(reinterpret_cast<__m256i*>(f3), _mm256_srli_epi64(_mm256_andnot_si256(left, columnBits), 1));
+      uint64_t* ab = faceMasks + (a - 1) + (b - 1) * CS;
+      for (int i = 0; i < 4; i++) {
+        ab[i * CS + 2 * CS_2] = f2[i];
+        ab[i * CS + 3 * CS_2] = f3[i];
+      }
     }
+    for (; b < CS_P - 1; b++)
+      Mesher<CS>::cullColumn(opaqueMask, faceMasks, a, b);
   }
+}
 
-  // Greedy meshing faces 0-3
-  for (int face = 0; face < 4; face++) {
-    const int axis = face / 2;
+// Compare + movemask, 32 voxels per instruction
+__attribute__((target("avx2"))) inline void buildOpaqueMaskAVX2(const uint8_t* voxels, uint64_t* opaqueMask) {
+  const __m256i zero = _mm256_setzero_si256();
+  for (int row = 0; row < CS_P2; row++) {
+    const uint8_t* v = voxels + row * CS_P;
+    const __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v));
+    const __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + 32));
+    const uint64_t airLo = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, zero)));
+    const uint64_t airHi = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, zero)));
+    opaqueMask[row] = ~(airLo | (airHi << 32));
+  }
+}
+#elif defined(__ARM_NEON)
+// 2 columns per instruction, same layout notes as the AVX2 version
+inline void cullFacesNEON(const uint64_t* opaqueMask, uint64_t* faceMasks) {
+  const uint64x2_t pMask = vdupq_n_u64(P_MASK);
+  for (int a = 1; a < CS_P - 1; a++) {
+    const uint64_t* row = opaqueMask + a * CS_P;
+    int b = 1;
+    for (; b + 2 <= CS_P - 1; b += 2) {
+      const uint64x2_t here = vld1q_u64(row + b);
+      const uint64x2_t columnBits = vandq_u64(here, pMask);
+
+      uint64_t* ba = faceMasks + (b - 1) + (a - 1) * CS;
+      vst1q_u64(ba + 0 * CS_2, vshrq_n_u64(vbicq_u64(columnBits, vld1q_u64(row + CS_P + b)), 1));
+      vst1q_u64(ba + 1 * CS_2, vshrq_n_u64(vbicq_u64(columnBits, vld1q_u64(row - CS_P + b)), 1));
+      vst1q_u64(ba + 4 * CS_2, vbicq_u64(columnBits, vshrq_n_u64(here, 1)));
+      vst1q_u64(ba + 5 * CS_2, vbicq_u64(columnBits, vshlq_n_u64(here, 1)));
+
+      const uint64x2_t f2 = vshrq_n_u64(vbicq_u64(columnBits, vld1q_u64(row + b + 1)), 1);
+      const uint64x2_t f3 = vshrq_n_u64(vbicq_u64(columnBits, vld1q_u64(row + b - 1)), 1);
+      uint64_t* ab = faceMasks + (a - 1) + (b - 1) * CS;
+      ab[2 * CS_2] = vgetq_lane_u64(f2, 0);
+      ab[CS + 2 * CS_2] = vgetq_lane_u64(f2, 1);
+      ab[3 * CS_2] = vgetq_lane_u64(f3, 0);
+      ab[CS + 3 * CS_2] = vgetq_lane_u64(f3, 1);
+    }
+    for (; b < CS_P - 1; b++)
+      Mesher<CS>::cullColumn(opaqueMask, faceMasks, a, b);
+  }
+}
 
-    const int faceVertexBegin = vertexI;
+// NEON has no movemask: weight each lane's compare result by its bit and add pairwise
+inline void buildOpaqueMaskNEON(const uint8_t* voxels, uint64_t* opaqueMask) {
+  static const uint8_t weightBytes[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+  const uint8x16_t weights = vld1q_u8(weightBytes);
+  for (int row = 0; row < CS_P2; row++) {
+    const uint8_t* v = voxels + row * CS_P;
+    uint8x16_t bytes[4];
+    for (int i = 0; i < 4; i++)
+      bytes[i] = vandq_u8(vtstq_u8(vld1q_u8(v + i * 16), vld1q_u8(v + i * 16)), weights);
+    // 64 weighted lanes -> 8 bytes, byte k holding z = 8k..8k+7
+    const uint8x16_t sum = vpaddq_u8(vpaddq_u8(bytes[0], bytes[1]), vpaddq_u8(bytes[2], bytes[3]));
+    opaqueMask[row] = vgetq_lane_u64(vreinterpretq_u64_u8(vpaddq_u8(sum, sum)), 0);
+  }
+}
+#endif
 
-    for (int layer = 0; layer < CS; layer++) {
-      const int bitsLocation = layer * CS + face * CS_2;
-
-      for (int forward = 0; forward < CS; forward++) {
-        uint64_t bitsHere = faceMasks[forward + bitsLocation];
-        if (bitsHere == 0) continue;
-
-        const uint64_t bitsNext = forward + 1 < CS ? faceMasks[(forward + 1) + bitsLocation] : 0;
-
-        uint8_t rightMerged = 1;
-        while (bitsHere) {
-          unsigned long bitPos;
-          #ifdef _MSC_VER
-            _BitScanForward64(&bitPos, bitsHere);
-          #else
-            bitPos = __builtin_ctzll(bitsHere);
-          #endif
-
-          const uint8_t type = voxels[getAxisIndex(axis, forward + 1, bitPos + 1, layer + 1)];
-          uint8_t& forwardMergedRef = forwardMerged[bitPos];
-
-          if ((bitsNext >> bitPos & 1) && type == voxels[getAxisIndex(axis, forward + 2, bitPos + 1, layer + 1)]) {
-            forwardMergedRef++;
-            bitsHere &= ~(1ull << bitPos);
-            continue;
-          }
-
-          for (int right = bitPos + 1; right < CS; right++) {
-            if (!(bitsHere >> right & 1) || forwardMergedRef != forwardMerged[right] || type != voxels[getAxisIndex(axis, forward + 1, right + 1, layer + 1)]) break;
-            forwardMerged[right] = 0;
-            rightMerged++;
-          }
-          bitsHere &= ~((1ull << (bitPos + rightMerged)) - 1);
-
-          const uint8_t meshFront = forward - forwardMergedRef;
-          const uint8_t meshLeft = bitPos;
-          const uint8_t meshUp = layer + (~face & 1);
-
-          const uint8_t meshWidth = rightMerged;
-          const uint8_t meshLength = forwardMergedRef + 1;
+// Hidden face culling for every interior column, on the widest kernel the CPU supports
+template <int Size = CS>
+inline void cullFaces(const MeshMask<Size>* opaqueMask, MeshMask<Size>* faceMasks) {
+  if constexpr (Size == CS) {
+#if (defined(__x86_64__) || defined(_M_X64)) && (defined(__GNUC__) || defined(__clang__))
+    if (mesherSimd() == MesherSimd::AVX2)
+      return cullFacesAVX2(opaqueMask, faceMasks);
+#elif defined(__ARM_NEON)
+    return cullFacesNEON(opaqueMask, faceMasks);
+#endif
+  }
+  Mesher<Size>::cullFacesScalar(opaqueMask, faceMasks);
+}
 
+// Rebuilds every opaque column mask of a padded ZXY grid from its voxels
+template <int Size = CS>
+inline void buildOpaqueMask(const uint8_t* voxels, MeshMask<Size>* opaqueMask) {
+  if constexpr (Size == CS) {
+#if (defined(__x86_64__) || defined(_M_X64)) && (defined(__GNUC__) || defined(__clang__))
+    if (mesherSimd() == MesherSimd::AVX2)
+      return buildOpaqueMaskAVX2(voxels, opaqueMask);
+#elif defined(__ARM_NEON)
+    return buildOpaqueMaskNEON(voxels, opaqueMask);
+#endif
+  }
+  Mesher<Size>::buildOpaqueMaskScalar(voxels, opaqueMask);
+}
+
+// Greedy meshing of one layer of faces 0-3 (a y layer for faces 0/1, an x layer for faces 2/3)
+template <int Size>
+void Mesher<Size>::meshLayer(const uint8_t* voxels, BasicMeshData<Size>& meshData, const int face, const int layer, int& vertexI) {
+  const int axis = face / 2;
+  const Mask* faceMasks = meshData.faceMasks;
+  uint8_t* forwardMerged = meshData.forwardMerged;
+  const int bitsLocation = layer * CS + face * CS_2;
+
+  for (int forward = 0; forward < CS; forward++) {
+    Mask bitsHere = faceMasks[forward + bitsLocation];
+    if (bitsHere == 0) continue;
+
+    const Mask bitsNext = forward + 1 < CS ? faceMasks[(forward + 1) + bitsLocation] : 0;
+
+    uint8_t rightMerged = 1;
+    while (bitsHere) {
+      unsigned long bitPos;
+      #ifdef _MSC_VER
+        _BitScanForward64(&bitPos, bitsHere);
+      #else
+        bitPos = __builtin_ctzll(bitsHere);
+      #endif
+
+      const uint8_t type = voxels[getAxisIndex(axis, forward + 1, bitPos + 1, layer + 1)];
+      uint8_t& forwardMergedRef = forwardMerged[bitPos];
+
+      if ((bitsNext >> bitPos & 1) && type == voxels[getAxisIndex(axis, forward + 2, bitPos + 1, layer + 1)]) {
+        forwardMergedRef++;
+        bitsHere &= ~(1ull << bitPos);
+        continue;
+      }
+
+      for (int right = bitPos + 1; right < CS; right++) {
+        if (!(bitsHere >> right & 1) || forwardMergedRef != forwardMerged[right] || type != voxels[getAxisIndex(axis, forward + 1, right + 1, layer + 1)]) break;
+        forwardMerged[right] = 0;
+        rightMerged++;
+      }
+      bitsHere &= ~((1ull << (bitPos + rightMerged)) - 1);
+
+      const uint8_t meshFront = forward - forwardMergedRef;
+      const uint8_t meshLeft = bitPos;
+      const uint8_t meshUp = layer + (~face & 1);
+
+      const uint8_t meshWidth = rightMerged;
+      const uint8_t meshLength = forwardMergedRef + 1;
+
+      forwardMergedRef = 0;
+      rightMerged = 1;
+
+      uint64_t quad;
+      switch (face) {
+      case 0:
+      case 1:
+        quad = getQuad(meshFront + (face == 1 ? meshLength : 0), meshUp, meshLeft, meshLength, meshWidth, type);
+        break;
+      case 2:
+      case 3:
+        quad = getQuad(meshUp, meshFront + (face == 2 ? meshLength : 0), meshLeft, meshLength, meshWidth, type);
+        break;
+      }
+
+      insertQuad(meshData.vertices, quad, vertexI);
+    }
+  }
+}
+
+// Greedy meshing of faces 4/5, restricted to the z layers set in bitFilter (padded bit positions).
+// Layers are independent, so a filtered pass emits exactly the quads a full pass emits for them.
+template <int Size>
+void Mesher<Size>::meshZFaces(const uint8_t* voxels, BasicMeshData<Size>& meshData, const int face, const Mask bitFilter, int& vertexI) {
+  const int axis = face / 2;
+  const Mask* faceMasks = meshData.faceMasks;
+  uint8_t* forwardMerged = meshData.forwardMerged;
+  uint8_t* rightMerged = meshData.rightMerged;
+
+  for (int forward = 0; forward < CS; forward++) {
+    const int bitsLocation = forward * CS + face * CS_2;
+    const int bitsForwardLocation = (forward + 1) * CS + face * CS_2;
+
+    for (int right = 0; right < CS; right++) {
+      Mask bitsHere = faceMasks[right + bitsLocation] & bitFilter;
+      if (bitsHere == 0) continue;
+
+      const Mask bitsForward = forward < CS - 1 ? faceMasks[right + bitsForwardLocation] & bitFilter : 0;
+      const Mask bitsRight = right < CS - 1 ? faceMasks[right + 1 + bitsLocation] & bitFilter : 0;
+      const int rightCS = right * CS;
+
+      while (bitsHere) {
+        unsigned long bitPos;
+        #ifdef _MSC_VER
+          _BitScanForward64(&bitPos, bitsHere);
+        #else
+          bitPos = __builtin_ctzll(bitsHere);
+        #endif
+
+        bitsHere &= ~(1ull << bitPos);
+
+        const uint8_t type = voxels[getAxisIndex(axis, right + 1, forward + 1, bitPos)];
+        uint8_t& forwardMergedRef = forwardMerged[rightCS + (bitPos - 1)];
+        uint8_t& rightMergedRef = rightMerged[bitPos - 1];
+
+        if (rightMergedRef == 0 && (bitsForward >> bitPos & 1) && type == voxels[getAxisIndex(axis, right + 1, forward + 2, bitPos)]) {
+          forwardMergedRef++;
+          continue;
+        }
+
+        if ((bitsRight >> bitPos & 1) && forwardMergedRef == forwardMerged[(rightCS + CS) + (bitPos - 1)] && type == voxels[getAxisIndex(axis, right + 2, forward + 1, bitPos)]) {
           forwardMergedRef = 0;
-          rightMerged = 1;
-
-          uint64_t quad;
-          switch (face) {
-          case 0:
-          case 1:
-            quad = getQuad(meshFront + (face == 1 ? meshLength : 0), meshUp, meshLeft, meshLength, meshWidth, type);
-            break;
-          case 2:
-          case 3:
-            quad = getQuad(meshUp, meshFront + (face == 2 ? meshLength : 0), meshLeft, meshLength, meshWidth, type);
-            break;
-          }
-
-          insertQuad(*meshData.vertices, quad, vertexI, meshData.maxVertices);
+          rightMergedRef++;
+          continue;
         }
+
+        const uint8_t meshLeft = right - rightMergedRef;
+        const uint8_t meshFront = forward - forwardMergedRef;
+        const uint8_t meshUp = bitPos - 1 + (~face & 1);
+
+        const uint8_t meshWidth = 1 + rightMergedRef;
+        const uint8_t meshLength = 1 + forwardMergedRef;
+
+        forwardMergedRef = 0;
+        rightMergedRef = 0;
+
+        const uint64_t quad = getQuad(meshLeft + (face == 4 ? meshWidth : 0), meshFront, meshUp, meshWidth, meshLength, type);
+
+        insertQuad(meshData.vertices, quad, vertexI);
       }
     }
+  }
+}
+
+template <int Size>
+void Mesher<Size>::mesh(const uint8_t* voxels, const Mask* opaqueMask, BasicMeshData<Size>& meshData) {
+  meshData.vertexCount = 0;
+  int vertexI = 0;
+
+  // Hidden face culling
+  cullFaces<Size>(opaqueMask, meshData.faceMasks);
+
+  // Greedy meshing faces 0-3
+  for (int face = 0; face < 4; face++) {
+    const int faceVertexBegin = vertexI;
+
+    for (int layer = 0; layer < CS; layer++) {
+      meshLayer(voxels, meshData, face, layer, vertexI);
+    }
 
     const int faceVertexLength = vertexI - faceVertexBegin;
     meshData.faceVertexBegin[face] = faceVertexBegin;
@@ -206,64 +550,10 @@ void mesh(const uint8_t* voxels, MeshData& meshData) {
 
   // Greedy meshing faces 4-5
   for (int face = 4; face < 6; face++) {
-    const int axis = face / 2;
-
     const int faceVertexBegin = vertexI;
 
-    for (int forward = 0; forward < CS; forward++) {
-      const int bitsLocation = forward * CS + face * CS_2;
-      const int bitsForwardLocation = (forward + 1) * CS + face * CS_2;
-
-      for (int right = 0; right < CS; right++) {
-        uint64_t bitsHere = faceMasks[right + bitsLocation];
-        if (bitsHere == 0) continue;
-
-        const uint64_t bitsForward = forward < CS - 1 ? faceMasks[right + bitsForwardLocation] : 0;
-        const uint64_t bitsRight = right < CS - 1 ? faceMasks[right + 1 + bitsLocation] : 0;
-        const int rightCS = right * CS;
-
-        while (bitsHere) {
-          unsigned long bitPos;
-          #ifdef _MSC_VER
-            _BitScanForward64(&bitPos, bitsHere);
-          #else
-            bitPos = __builtin_ctzll(bitsHere);
-          #endif
-
-          bitsHere &= ~(1ull << bitPos);
-
-          const uint8_t type = voxels[getAxisIndex(axis, right + 1, forward + 1, bitPos)];
-          uint8_t& forwardMergedRef = forwardMerged[rightCS + (bitPos - 1)];
-          uint8_t& rightMergedRef = rightMerged[bitPos - 1];
-          
-          if (rightMergedRef == 0 && (bitsForward >> bitPos & 1) && type == voxels[getAxisIndex(axis, right + 1, forward + 2, bitPos)]) {
-            forwardMergedRef++;
-            continue;
-          }
-          
-          if ((bitsRight >> bitPos & 1) && forwardMergedRef == forwardMerged[(rightCS + CS) + (bitPos - 1)] && type == voxels[getAxisIndex(axis, right + 2, forward + 1, bitPos)]) {
-            forwardMergedRef = 0;
-            rightMergedRef++;
-            continue;
-          }
-
-          const uint8_t meshLeft = right - rightMergedRef;
-          const uint8_t meshFront = forward - forwardMergedRef;
-          const uint8_t meshUp = bitPos - 1 + (~face & 1);
-
-          const uint8_t meshWidth = 1 + rightMergedRef;
-          const uint8_t meshLength = 1 + forwardMergedRef;
+    meshZFaces(voxels, meshData, face, ~Mask(0), vertexI);
 
-          forwardMergedRef = 0;
-          rightMergedRef = 0;
-          
-          const uint64_t quad = getQuad(meshLeft + (face == 4 ? meshWidth : 0), meshFront, meshUp, meshWidth, meshLength, type);
-
-          insertQuad(*meshData.vertices, quad, vertexI, meshData.maxVertices);
-        }
-      }
-    }
-  
     const int faceVertexLength = vertexI - faceVertexBegin;
     meshData.faceVertexBegin[face] = faceVertexBegin;
     meshData.faceVertexLength[face] =faceVertexLength;
@@ -271,4 +561,82 @@ void mesh(const uint8_t* voxels, MeshData& meshData) {
 
   meshData.vertexCount = vertexI + 1;
 }
+
+// Layer of a quad along its face's axis, i.e. the layer meshLayer / meshZFaces emitted it for
+inline int quadLayer(const uint64_t quad, const int face) {
+  const int shift = face < 2 ? 6 : face < 4 ? 0 : 12;
+  return static_cast<int>((quad >> shift) & 63) - ((face & 1) == 0 ? 1 : 0);
 }
+
+template <int Size>
+int Mesher<Size>::remesh(const uint8_t* voxels, const Mask* opaqueMask, BasicMeshData<Size>& meshData, const int x, const int y, const int z) {
+  Mask* faceMasks = meshData.faceMasks;
+  const int px = x + 1, py = y + 1;
+
+  // Only the edited column and its 4 neighbours can see their face masks change
+  const int columns[5][2] = { { py, px }, { py - 1, px }, { py + 1, px }, { py, px - 1 }, { py, px + 1 } };
+  for (const auto& [a, b] : columns) {
+    if (a >= 1 && a <= CS && b >= 1 && b <= CS)
+      cullColumn(opaqueMask, faceMasks, a, b);
+  }
+
+  // The previous quads stay where they are; each face is rebuilt into the spare area: kept
+  // quads outside the touched layers, then freshly meshed quads for those layers
+  const uint64_t* previous = meshData.vertices;
+  uint64_t* vertices = meshData.spareVertices;
+  meshData.vertices = vertices;
+  meshData.spareVertices = const_cast<uint64_t*>(previous);
+  int previousBegin[6], previousLength[6];
+  std::memcpy(previousBegin, meshData.faceVertexBegin, sizeof(previousBegin));
+  std::memcpy(previousLength, meshData.faceVertexLength, sizeof(previousLength));
+
+  int changedFaces = 0;
+  int vertexI = 0;
+  for (int face = 0; face < 6; face++) {
+    const int c = face < 2 ? y : face < 4 ? x : z;
+    const int lo = c - 1 < 0 ? 0 : c - 1;
+    const int hi = c + 1 > CS - 1 ? CS - 1 : c + 1;
+    const int faceVertexBegin = vertexI;
+
+    for (int i = 0; i < previousLength[face]; i++) {
+      const uint64_t quad = previous[previousBegin[face] + i];
+      const int layer = quadLayer(quad, face);
+      if (layer < lo || layer > hi)
+        insertQuad(vertices, quad, vertexI);
+    }
+    const int keptEnd = vertexI;
+
+    if (face < 4) {
+      for (int layer = lo; layer <= hi; layer++)
+        meshLayer(voxels, meshData, face, layer, vertexI);
+    } else if (lo <= hi) {
+      const Mask bitFilter = ((Mask(1) << (hi - lo + 1)) - 1) << (lo + 1);
+      meshZFaces(voxels, meshData, face, bitFilter, vertexI);
+    }
+
+    meshData.faceVertexBegin[face] = faceVertexBegin;
+    meshData.faceVertexLength[face] = vertexI - faceVertexBegin;
+
+    // Kept quads keep their relative order, so the face only changed if the layers did
+    const int removed = previousLength[face] - (keptEnd - faceVertexBegin);
+    bool changed = removed != vertexI - keptEnd;
+    // Same count: the old quads of the layers against the new ones, in order
+    for (int i = 0, next = keptEnd; !changed && i < previousLength[face]; i++) {
+      const uint64_t quad = previous[previousBegin[face] + i];
+      const int layer = quadLayer(quad, face);
+      if (layer >= lo && layer <= hi)
+        changed = vertices[next++] != quad;
+    }
+    if (changed)
+      changedFaces |= 1 << face;
+  }
+
+  meshData.vertexCount = vertexI + 1;
+  return changedFaces;
+}
+}
+
+// The chunk sizes there are builds and benchmarks for
+template struct Mesher<16>;
+template struct Mesher<30>;
+template struct Mesher<62>;
@@ -0,0 +1,99 @@
+module;
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+export module quad_format;
+
+export {
+  // Chunk quads are meshed as 8 bytes each (getQuad(): x, y, z, w, h 6 bits each, block type
+  // from bit 32) and stay that way in memory. What goes to the quad buffer is picked at build
+  // time: the same 8 bytes, or with COMPACT_QUADS (xmake f --compact_quads=y) 4 bytes:
+  //
+  //   x, y, z    6 bits each
+  //   w - 1      5 bits
+  //   h - 1      5 bits
+  //   palette    4 bits, index into the chunk's QuadPalette
+  //
+  // Quads wider or higher than 32 are split to fit, so there can be a few more of them.
+  // main.vs draws the first layout, main_compact.vs the second.
+#if defined(COMPACT_QUADS) && defined(REGION_BATCHES)
+#error "REGION_BATCHES keeps each quad's chunk in bits 4 byte quads don't have"
+#endif
+#if defined(COMPACT_QUADS)
+  using PackedQuad = std::uint32_t;
+#else
+  using PackedQuad = std::uint64_t;
+#endif
+  constexpr std::uint32_t QUAD_SIZE = sizeof(PackedQuad);
+
+  constexpr int COMPACT_MAX_EXTENT = 32;
+  constexpr int PALETTE_SIZE = 16;
+
+  // A chunk's block types by palette index, in ascending order. 16 bytes, a uvec4 to the shader
+  struct QuadPalette {
+    std::uint8_t types[PALETTE_SIZE] = {};
+
+    bool operator==(const QuadPalette&) const = default;
+  };
+
+  // The distinct block types of a mesh's quads, face f at quads + faceBegin[f]. A mesh with
+  // more than PALETTE_SIZE types draws the rest as the last one
+  QuadPalette build_palette(const std::uint64_t* quads, const int* faceBegin, const int* faceLength) noexcept {
+    std::uint64_t seen[4] = {};
+    for (int face = 0; face < 6; face++)
+      for (int i = faceBegin[face]; i < faceBegin[face] + faceLength[face]; i++) {
+        const std::uint8_t type = static_cast<std::uint8_t>(quads[i] >> 32);
+        seen[type >> 6] |= std::uint64_t(1) << (type & 63);
+      }
+
+    QuadPalette palette;
+    int count = 0;
+    for (int word = 0; word < 4 && count < PALETTE_SIZE; word++)
+      for (std::uint64_t bits = seen[word]; bits && count < PALETTE_SIZE; bits &= bits - 1)
+        palette.types[count++] = static_cast<std::uint8_t>(word * 64 + std::countr_zero(bits));
+    return palette;
+  }
+
+  // Packs `count` quads of one face into out, which needs room for 4 * count. Returns how many
+  // it wrote
+  int compact_quads(const std::uint64_t* quads, int count, int face, const QuadPalette& palette,
+      std::uint32_t* out) noexcept {
+    std::uint8_t index[256];
+    std::fill(std::begin(index), std::end(index), std::uint8_t(PALETTE_SIZE - 1));
+    for (int i = PALETTE_SIZE - 1; i >= 0; i--)
+      index[palette.types[i]] = static_cast<std::uint8_t>(i);
+    // See main.vs: a quad spans w along wAxis (backwards on flipped faces) and h along hAxis
+    constexpr int FLIP[6] = { 1, -1, -1, 1, -1, 1 };
+    const int wAxis = (face & 2) >> 1, hAxis = 2 - (face >> 2);
+
+    int written = 0;
+    for (int i = 0; i < count; i++) {
+      const std::uint64_t quad = quads[i];
+      const int pos[3] = { int(quad & 63), int(quad >> 6 & 63), int(quad >> 12 & 63) };
+      const int w = int(quad >> 18 & 63), h = int(quad >> 24 & 63);
+      const std::uint32_t paletteBits = std::uint32_t(index[static_cast<std::uint8_t>(quad >> 32)]) << 28;
+      if (w <= COMPACT_MAX_EXTENT && h <= COMPACT_MAX_EXTENT) {
+        out[written++] = paletteBits | std::uint32_t(h - 1) << 23 | std::uint32_t(w - 1) << 18 | std::uint32_t(quad & 0x3ffff);
+        continue;
+      }
+
+      for (int wDone = 0; wDone < w; wDone += COMPACT_MAX_EXTENT) {
+        for (int hDone = 0; hDone < h; hDone += COMPACT_MAX_EXTENT) {
+          int piece[3] = { pos[0], pos[1], pos[2] };
+          piece[wAxis] += wDone * FLIP[face];
+          piece[hAxis] += hDone;
+          const int pieceW = std::min(w - wDone, COMPACT_MAX_EXTENT), pieceH = std::min(h - hDone, COMPACT_MAX_EXTENT);
+          out[written++] = paletteBits | std::uint32_t(pieceH - 1) << 23 | std::uint32_t(pieceW - 1) << 18 |
+            std::uint32_t(piece[2]) << 12 | std::uint32_t(piece[1]) << 6 | std::uint32_t(piece[0]);
+        }
+      }
+    }
+    return written;
+  }
+
+  // A compact quad back in getQuad()'s layout
+  std::uint64_t expand_quad(std::uint32_t quad, const QuadPalette& palette) noexcept {
+    const std::uint64_t w = (quad >> 18 & 31) + 1, h = (quad >> 23 & 31) + 1;
+    return std::uint64_t(palette.types[quad >> 28]) << 32 | h << 24 | w << 18 | (quad & 0x3ffff);
+  }
+}
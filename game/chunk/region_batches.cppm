@@ -0,0 +1,222 @@
+module;
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+export module region_batches;
+
+import glm;
+import chunk_map;
+import draw_command;
+import draw_table;
+
+export {
+  constexpr int REGION_BITS = 2;
+  constexpr int REGION_SIZE = 1 << REGION_BITS; // chunks along each axis
+  constexpr int REGION_CHUNKS = REGION_SIZE * REGION_SIZE * REGION_SIZE;
+  // Where a batched quad keeps its chunk's slot in the region, above the block type
+  constexpr int REGION_SLOT_SHIFT = 40;
+
+  inline glm::ivec3 region_of(const glm::ivec3& chunk_pos) noexcept {
+    return glm::ivec3(chunk_pos.x >> REGION_BITS, chunk_pos.y >> REGION_BITS, chunk_pos.z >> REGION_BITS);
+  }
+
+  // x + 4 * (y + 4 * z) within the region, what main.vs reads back from the quads
+  inline int region_slot(const glm::ivec3& chunk_pos) noexcept {
+    constexpr int MASK = REGION_SIZE - 1;
+    return (chunk_pos.x & MASK) | (chunk_pos.y & MASK) << REGION_BITS | (chunk_pos.z & MASK) << (2 * REGION_BITS);
+  }
+
+  struct RegionBatchStats {
+    std::size_t regions = 0;
+    std::size_t rebuilds = 0;      // region faces moved to a new slot by the last flush()
+    std::size_t uploadedQuads = 0; // by the last flush(), from the CPU
+    std::size_t copiedQuads = 0;   // by the last flush(), on the GPU from a rebuilt face's old slot
+  };
+
+  // Chunks grouped into REGION_SIZE^3 regions, each face of a region drawn with one command:
+  // the quads of all its chunks for that face one after the other, in slot order, every quad
+  // with its chunk's slot at REGION_SLOT_SHIFT. The DrawTable flush() writes to has a row per
+  // region instead of per chunk, baseInstance is the region's first chunk (packed against the
+  // render origin, see pack_base_instance()) and main.vs adds the slot to it.
+  //
+  // update() only queues a chunk's new quads. flush() then rebuilds each region face they
+  // touch once: a slot for the whole batch, the queued quads uploaded into it and the other
+  // chunks' copied over from the old slot on the GPU. When no chunk's quad count changed, the
+  // queued quads are written over the old ones instead.
+  //
+  // Renderer allocates and fills the quad buffer's slots, ChunkRenderer or a mock in
+  // bench_region_batches:
+  //   DrawArraysIndirectCommand getDrawCommand(int quadCount, std::uint32_t baseInstance)
+  //   void removeDrawCommand(const DrawArraysIndirectCommand&)
+  //   void bufferQuads(std::uint32_t startQuad, std::uint32_t quadCount, const void* quads)
+  //   void copyQuads(std::uint32_t from, std::uint32_t to, std::uint32_t quadCount)
+  class RegionBatches {
+  public:
+    // Replaces the chunk's quads of one face, count of them (0 removes them)
+    void update(const glm::ivec3& chunk_pos, int face, const std::uint64_t* quads, int count) {
+      const int slot = region_slot(chunk_pos);
+      pending.push_back(Pending{ region_of(chunk_pos), face, slot, pendingQuads.size(), count });
+      const std::uint64_t slotBits = std::uint64_t(slot) << REGION_SLOT_SHIFT;
+      for (int i = 0; i < count; i++)
+        pendingQuads.push_back(quads[i] | slotBits);
+    }
+
+    // Every face of the chunk
+    void remove(const glm::ivec3& chunk_pos) {
+      for (int face = 0; face < 6; face++)
+        update(chunk_pos, face, nullptr, 0);
+    }
+
+    // Whether the chunk has quads, flushed or not
+    bool contains(const glm::ivec3& chunk_pos) const {
+      const glm::ivec3 region = region_of(chunk_pos);
+      const int slot = region_slot(chunk_pos);
+      const auto found = regions.find(region);
+      for (int face = 0; face < 6; face++) {
+        // The face's last queued update if it has one, what was flushed otherwise
+        auto it = std::find_if(pending.rbegin(), pending.rend(), [&](const Pending& update) {
+          return update.region == region && update.slot == slot && update.face == face;
+        });
+        if (it != pending.rend() ? it->count > 0 : found != regions.end() && found->second.counts[face][slot] > 0)
+          return true;
+      }
+      return false;
+    }
+
+    // Applies the queued updates, before table is culled. Rebuilt faces get their baseInstance
+    // packed against origin, the others keep theirs
+    template <typename Renderer>
+    void flush(DrawTable& table, Renderer& renderer, const glm::ivec3& origin) {
+      stats.rebuilds = stats.uploadedQuads = stats.copiedQuads = 0;
+      // By region and face, a chunk's later updates after its earlier ones
+      std::stable_sort(pending.begin(), pending.end(), [](const Pending& a, const Pending& b) {
+        return std::tie(a.region.x, a.region.y, a.region.z, a.face) < std::tie(b.region.x, b.region.y, b.region.z, b.face);
+      });
+      for (std::size_t begin = 0; begin < pending.size();) {
+        std::size_t end = begin + 1;
+        while (end < pending.size() && pending[end].region == pending[begin].region && pending[end].face == pending[begin].face)
+          end++;
+        rebuild(table, renderer, origin, begin, end);
+        begin = end;
+      }
+      pending.clear();
+      pendingQuads.clear();
+      stats.regions = regions.size();
+    }
+
+    const RegionBatchStats& get_stats() const noexcept { return stats; }
+
+  private:
+    struct Region {
+      std::uint32_t counts[6][REGION_CHUNKS] = {}; // quads per face and slot
+    };
+
+    struct Pending {
+      glm::ivec3 region;
+      int face;
+      int slot;
+      std::size_t begin; // in pendingQuads
+      int count;
+    };
+
+    // One region face with pending[begin, end)
+    template <typename Renderer>
+    void rebuild(DrawTable& table, Renderer& renderer, const glm::ivec3& origin, std::size_t begin, std::size_t end) {
+      const glm::ivec3 regionPos = pending[begin].region;
+      const int face = pending[begin].face;
+      const Pending* updated[REGION_CHUNKS] = {};
+      bool adds = false;
+      for (std::size_t i = begin; i < end; i++) {
+        updated[pending[i].slot] = &pending[i];
+        adds |= pending[i].count > 0;
+      }
+
+      auto found = regions.find(regionPos);
+      if (found == regions.end()) {
+        if (!adds)
+          return;
+        found = regions.try_emplace(regionPos).first;
+      }
+      std::uint32_t* counts = found->second.counts[face];
+      const std::size_t row = table.row(regionPos);
+      DrawArraysIndirectCommand& command = table.command(row, face);
+
+      const auto quads = [this](const Pending* update) { return pendingQuads.data() + update->begin; };
+      bool sameCounts = command.count > 0;
+      std::uint32_t newCounts[REGION_CHUNKS];
+      std::uint32_t total = 0;
+      for (int slot = 0; slot < REGION_CHUNKS; slot++) {
+        newCounts[slot] = updated[slot] ? std::uint32_t(updated[slot]->count) : counts[slot];
+        sameCounts &= newCounts[slot] == counts[slot];
+        total += newCounts[slot];
+      }
+
+      if (sameCounts) {
+        std::uint32_t at = command.first / 6;
+        for (int slot = 0; slot < REGION_CHUNKS; slot++) {
+          if (updated[slot]) {
+            renderer.bufferQuads(at, counts[slot], quads(updated[slot]));
+            stats.uploadedQuads += counts[slot];
+          }
+          at += counts[slot];
+        }
+        return;
+      }
+
+      const DrawArraysIndirectCommand old = command;
+      command = {};
+      if (total > 0) {
+        command = renderer.getDrawCommand(int(total), pack_base_instance(face, regionPos * REGION_SIZE, origin));
+        // Out of buffer space, already logged: the region face isn't drawn
+        if (command.count == 0)
+          std::fill(std::begin(newCounts), std::end(newCounts), 0u);
+      }
+
+      if (command.count > 0) {
+        // Chunks next to each other that kept their quads are copied in one go
+        std::uint32_t from = old.first / 6, to = command.first / 6;
+        std::uint32_t runFrom = 0, runTo = 0, run = 0;
+        const auto copyRun = [&] {
+          if (run > 0)
+            renderer.copyQuads(runFrom, runTo, run);
+          stats.copiedQuads += run;
+          run = 0;
+        };
+        for (int slot = 0; slot < REGION_CHUNKS; slot++) {
+          if (updated[slot]) {
+            copyRun();
+            renderer.bufferQuads(to, newCounts[slot], quads(updated[slot]));
+            stats.uploadedQuads += newCounts[slot];
+          } else if (counts[slot] > 0) {
+            if (run == 0) {
+              runFrom = from;
+              runTo = to;
+            }
+            run += counts[slot];
+          }
+          from += counts[slot];
+          to += newCounts[slot];
+        }
+        copyRun();
+      }
+      renderer.removeDrawCommand(old);
+      std::copy(std::begin(newCounts), std::end(newCounts), counts);
+      stats.rebuilds++;
+
+      for (int f = 0; f < 6; f++)
+        if (std::as_const(table).command(row, f).count > 0)
+          return;
+      table.remove(regionPos, [](DrawArraysIndirectCommand&) {});
+      regions.erase(found);
+    }
+
+    std::unordered_map<glm::ivec3, Region, ivec3_hash> regions;
+    std::vector<Pending> pending;
+    std::vector<std::uint64_t> pendingQuads; // the pending updates', slot bits set
+    RegionBatchStats stats;
+  };
+}
@@ -0,0 +1,153 @@
+module;
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+export module upload_queue;
+
+import glm;
+import chunk_map;
+import job_system;
+
+export {
+  struct UploadQueueStats {
+    std::size_t depth = 0;       // entries waiting, superseded ones not counted
+    std::size_t bytes = 0;       // of the entries waiting
+    std::size_t pushed = 0;
+    std::size_t popped = 0;
+    std::size_t superseded = 0;  // dropped for a newer entry of the same chunk
+    double lastLatencyMs = 0.0;  // push to pop, of the last entry popped
+    double meanLatencyMs = 0.0;  // moving average over the last few dozen
+    double maxLatencyMs = 0.0;
+  };
+
+  // Finished chunk meshes waiting to be uploaded. Workers push() from any thread; the frame
+  // loop takes them in with collect() and pops them nearest to the center first, as many as
+  // its upload budget allows (next_bytes() tells what the next one costs before it's popped).
+  //
+  // Every entry carries the sequence number of the request it answers. Of two entries for
+  // the same chunk only the later request's is kept, the other is handed to drop() (it still
+  // owns whatever the job was given) without ever being uploaded.
+  template <typename T>
+  class UploadQueue {
+  public:
+    UploadQueue() = default;
+    UploadQueue(const UploadQueue&) = delete;
+    UploadQueue& operator=(const UploadQueue&) = delete;
+
+    // Any thread
+    void push(const glm::ivec3& chunk_pos, std::uint64_t sequence, std::size_t bytes, T item) {
+      incoming.push(Entry{ std::move(item), chunk_pos, sequence, bytes, 0, Clock::now() });
+    }
+
+    // Takes in everything pushed so far, dropping superseded entries. Returns how many were
+    // pushed, dropped ones included
+    template <typename Drop>
+    std::size_t collect(Drop&& drop) {
+      return incoming.drain([&](Entry&& entry) {
+        stats.pushed++;
+        auto [it, inserted] = newest.try_emplace(entry.chunkPos, Live{ entry.sequence, entry.bytes });
+        if (!inserted) {
+          // Finished out of order: the later request's entry is already here
+          if (it->second.sequence > entry.sequence) {
+            stats.superseded++;
+            drop(std::move(entry.item));
+            return;
+          }
+          // The earlier entry stays in the heap until it comes up, and is dropped then
+          stats.superseded++;
+          stats.depth--;
+          stats.bytes -= it->second.bytes;
+          it->second = Live{ entry.sequence, entry.bytes };
+        }
+        stats.depth++;
+        stats.bytes += entry.bytes;
+        entry.distance = distance(entry.chunkPos);
+        heap.push_back(std::move(entry));
+        std::push_heap(heap.begin(), heap.end(), farther);
+      });
+    }
+
+    // Nearest to center goes first from now on
+    void recenter(const glm::ivec3& new_center) {
+      center = new_center;
+      for (Entry& entry : heap)
+        entry.distance = distance(entry.chunkPos);
+      std::make_heap(heap.begin(), heap.end(), farther);
+    }
+
+    // Bytes of the entry pop() returns next, nullopt when there's none. Superseded entries on
+    // top are dropped on the way
+    template <typename Drop>
+    std::optional<std::size_t> next_bytes(Drop&& drop) {
+      while (!heap.empty()) {
+        Entry& top = heap.front();
+        if (auto it = newest.find(top.chunkPos); it != newest.end() && it->second.sequence == top.sequence)
+          return top.bytes;
+        drop(std::move(top.item));
+        pop_heap();
+      }
+      return std::nullopt;
+    }
+
+    // The nearest entry; only after next_bytes() returned something
+    T pop() {
+      Entry& top = heap.front();
+      T item = std::move(top.item);
+      newest.erase(top.chunkPos);
+      stats.depth--;
+      stats.bytes -= top.bytes;
+      stats.popped++;
+
+      const double latency = std::chrono::duration<double, std::milli>(Clock::now() - top.pushed).count();
+      stats.lastLatencyMs = latency;
+      stats.meanLatencyMs = stats.popped == 1 ? latency : stats.meanLatencyMs + (latency - stats.meanLatencyMs) / 32.0;
+      stats.maxLatencyMs = std::max(stats.maxLatencyMs, latency);
+      pop_heap();
+      return item;
+    }
+
+    bool empty() const noexcept { return stats.depth == 0; }
+    std::size_t size() const noexcept { return stats.depth; }
+    const UploadQueueStats& get_stats() const noexcept { return stats; }
+
+  private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+      T item;
+      glm::ivec3 chunkPos;
+      std::uint64_t sequence;
+      std::size_t bytes;
+      int distance; // squared, in chunks from center
+      Clock::time_point pushed;
+    };
+
+    struct Live {
+      std::uint64_t sequence;
+      std::size_t bytes;
+    };
+
+    static bool farther(const Entry& a, const Entry& b) { return a.distance > b.distance; }
+
+    int distance(const glm::ivec3& chunk_pos) const {
+      const glm::ivec3 d = chunk_pos - center;
+      return d.x * d.x + d.y * d.y + d.z * d.z;
+    }
+
+    void pop_heap() {
+      std::pop_heap(heap.begin(), heap.end(), farther);
+      heap.pop_back();
+    }
+
+    CompletionQueue<Entry> incoming;
+    std::vector<Entry> heap; // min-heap on distance, superseded entries included
+    std::unordered_map<glm::ivec3, Live, ivec3_hash> newest; // chunk -> its entry that isn't superseded
+    glm::ivec3 center{ 0 };
+    UploadQueueStats stats;
+  };
+}
@@ -5,7 +5,6 @@ module;
 #include <string>
 #include <string_view>
 #include <cstdio>
-#include <bit>
 export module core;
 
 import glm;
@@ -95,61 +94,42 @@ export {
     }
   }
 
-	// WARNING: CHUNK_SIZE ≤ 32 because of how the voxel faces are packed in the GPU buffer
-	inline constexpr glm::ivec3 CHUNK_SIZE{16};
+	// Chunks are meshed by the binary greedy mesher, which works on 62^3 chunks (64^3 with
+	// a one voxel border) and packs positions in 6 bits: CHUNK_SIZE must stay ≤ 62 and match CS
+	inline constexpr glm::ivec3 CHUNK_SIZE{62};
 	static_assert(CHUNK_SIZE.x > 0 && CHUNK_SIZE.y > 0 && CHUNK_SIZE.z > 0, "CHUNK_SIZE must be positive");
-	static_assert(
-			(CHUNK_SIZE.x & (CHUNK_SIZE.x - 1)) == 0 &&
-			(CHUNK_SIZE.y & (CHUNK_SIZE.y - 1)) == 0 &&
-			(CHUNK_SIZE.z & (CHUNK_SIZE.z - 1)) == 0,
-			"CHUNK_SIZE must be a power of two"
-			);
+	static_assert(CHUNK_SIZE.x <= 62 && CHUNK_SIZE.y <= 62 && CHUNK_SIZE.z <= 62, "CHUNK_SIZE must fit in the 6 bit quad packing");
 	inline constexpr int SIZE = CHUNK_SIZE.x * CHUNK_SIZE.y * CHUNK_SIZE.z;
 	inline constexpr int TOTAL_FACES = SIZE * 6;
-	inline constexpr glm::ivec3 LOG_SIZE{
-		std::countr_zero(static_cast<unsigned>(CHUNK_SIZE.x)),
-		std::countr_zero(static_cast<unsigned>(CHUNK_SIZE.y)),
-		std::countr_zero(static_cast<unsigned>(CHUNK_SIZE.z))
-	};
 
-	inline glm::ivec3 world_to_chunk(const glm::vec3 &world_pos) noexcept {
-		glm::ivec3 block = glm::floor(world_pos); // convert to integer block coordinates
-		return {
-			block.x >> LOG_SIZE.x,
-				block.y >> LOG_SIZE.y,
-				block.z >> LOG_SIZE.z
-		};
-	}
+	// Rounds towards negative infinity, unlike '/' and '%'
+	inline constexpr int floor_div(int a, int b) noexcept { return a / b - ((a % b != 0) && ((a < 0) != (b < 0))); }
+	inline constexpr int floor_mod(int a, int b) noexcept { int m = a % b; return m < 0 ? m + b : m; }
 
-  inline glm::ivec3 world_to_chunk(const glm::ivec3 &world_pos) noexcept {
-    return {
-      world_pos.x >> LOG_SIZE.x,
-      world_pos.y >> LOG_SIZE.y,
-      world_pos.z >> LOG_SIZE.z
-    };
-  }
-	inline glm::ivec3 world_to_local(const glm::vec3 &world_pos) noexcept {
-		glm::ivec3 block = glm::floor(world_pos);
+	inline glm::ivec3 world_to_chunk(const glm::ivec3 &world_pos) noexcept {
 		return {
-			block.x & (CHUNK_SIZE.x - 1),
-				block.y & (CHUNK_SIZE.y - 1),
-				block.z & (CHUNK_SIZE.z - 1)
+			floor_div(world_pos.x, CHUNK_SIZE.x),
+				floor_div(world_pos.y, CHUNK_SIZE.y),
+				floor_div(world_pos.z, CHUNK_SIZE.z)
 		};
 	}
+	inline glm::ivec3 world_to_chunk(const glm::vec3 &world_pos) noexcept {
+		return world_to_chunk(glm::ivec3(glm::floor(world_pos))); // convert to integer block coordinates
+	}
+
 	inline glm::ivec3 world_to_local(const glm::ivec3 &world_pos) noexcept {
 		return {
-			world_pos.x & (CHUNK_SIZE.x - 1),
-				world_pos.y & (CHUNK_SIZE.y - 1),
-				world_pos.z & (CHUNK_SIZE.z - 1)
+			floor_mod(world_pos.x, CHUNK_SIZE.x),
+				floor_mod(world_pos.y, CHUNK_SIZE.y),
+				floor_mod(world_pos.z, CHUNK_SIZE.z)
 		};
 	}
+	inline glm::ivec3 world_to_local(const glm::vec3 &world_pos) noexcept {
+		return world_to_local(glm::ivec3(glm::floor(world_pos)));
+	}
 
 	inline glm::vec3 chunk_to_world(const glm::ivec3 &chunk_pos) noexcept {
-		return glm::vec3{
-			chunk_pos.x << LOG_SIZE.x,
-				chunk_pos.y << LOG_SIZE.y,
-				chunk_pos.z << LOG_SIZE.z
-		};
+		return glm::vec3(chunk_pos * CHUNK_SIZE);
 	}
 
 
@@ -0,0 +1,189 @@
+module;
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <utility>
+#include <vector>
+export module job_system;
+
+export {
+  // Multi-producer / single-consumer queue for finished work: workers push() from any thread,
+  // the frame loop takes everything at once with drain(). Lock-free (a Treiber stack that is
+  // only ever emptied as a whole, so there's no ABA), results come out in completion order.
+  template <typename T>
+  class CompletionQueue {
+  public:
+    CompletionQueue() = default;
+    ~CompletionQueue() { drain([](T&&) {}); }
+
+    CompletionQueue(const CompletionQueue&) = delete;
+    CompletionQueue& operator=(const CompletionQueue&) = delete;
+
+    void push(T value) {
+      Node* node = new Node{ std::move(value), head.load(std::memory_order_relaxed) };
+      while (!head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {}
+    }
+
+    // fn(T&&) for every queued value, oldest first. Returns how many there were.
+    template <typename Fn>
+    std::size_t drain(Fn&& fn) {
+      Node* node = head.exchange(nullptr, std::memory_order_acquire);
+
+      Node* oldest = nullptr;
+      while (node) {
+        Node* next = node->next;
+        node->next = oldest;
+        oldest = node;
+        node = next;
+      }
+
+      std::size_t count = 0;
+      while (oldest) {
+        Node* next = oldest->next;
+        fn(std::move(oldest->value));
+        delete oldest;
+        oldest = next;
+        ++count;
+      }
+      return count;
+    }
+
+    bool empty() const noexcept { return head.load(std::memory_order_acquire) == nullptr; }
+
+  private:
+    struct Node {
+      T value;
+      Node* next;
+    };
+    std::atomic<Node*> head{nullptr};
+  };
+
+  // Fixed pool of worker threads with one job queue each. A worker runs its own queue
+  // front to back and steals from the back of the others when it runs dry, so jobs
+  // submitted in priority order still start roughly in that order.
+  //
+  // Jobs get the index of the worker running them, for per-worker scratch memory
+  // (MeshData, voxel buffers...) that the owner allocates up front.
+  class JobSystem {
+  public:
+    using Job = std::function<void(unsigned worker)>;
+
+    explicit JobSystem(unsigned worker_count = default_worker_count()) {
+      worker_count = std::max(worker_count, 1u);
+      for (unsigned i = 0; i < worker_count; i++)
+        workers.emplace_back(std::make_unique<Worker>());
+      for (unsigned i = 0; i < worker_count; i++)
+        threads.emplace_back([this, i](std::stop_token stop) { run(i, stop); });
+    }
+
+    // Jobs still queued are dropped, running ones finish first
+    ~JobSystem() {
+      for (std::jthread& thread : threads)
+        thread.request_stop();
+      {
+        std::scoped_lock lock(sleep_mutex);
+      }
+      wake.notify_all();
+      threads.clear();
+    }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // Leaves a core for the main thread
+    static unsigned default_worker_count() noexcept {
+      const unsigned cores = std::thread::hardware_concurrency();
+      return cores > 2 ? cores - 1 : 1;
+    }
+
+    void submit(Job job) {
+      pending.fetch_add(1, std::memory_order_relaxed);
+      Worker& target = *workers[next_queue.fetch_add(1, std::memory_order_relaxed) % workers.size()];
+      {
+        std::scoped_lock lock(target.mutex);
+        target.jobs.push_back(std::move(job));
+      }
+      queued.fetch_add(1, std::memory_order_release);
+
+      // Taking the lock orders this against a worker that is about to go to sleep
+      {
+        std::scoped_lock lock(sleep_mutex);
+      }
+      wake.notify_one();
+    }
+
+    // Blocks until every submitted job has finished
+    void wait_idle() const noexcept {
+      for (std::size_t n = pending.load(std::memory_order_acquire); n != 0; n = pending.load(std::memory_order_acquire))
+        pending.wait(n, std::memory_order_acquire);
+    }
+
+    unsigned worker_count() const noexcept { return static_cast<unsigned>(workers.size()); }
+
+    // Submitted but not finished yet
+    std::size_t pending_jobs() const noexcept { return pending.load(std::memory_order_relaxed); }
+
+  private:
+    struct alignas(64) Worker {
+      std::mutex mutex;
+      std::deque<Job> jobs;
+    };
+
+    bool try_pop(unsigned index, Job& out) {
+      {
+        Worker& own = *workers[index];
+        std::scoped_lock lock(own.mutex);
+        if (!own.jobs.empty()) {
+          out = std::move(own.jobs.front());
+          own.jobs.pop_front();
+          return true;
+        }
+      }
+      for (std::size_t i = 1; i < workers.size(); i++) {
+        Worker& victim = *workers[(index + i) % workers.size()];
+        std::scoped_lock lock(victim.mutex);
+        if (!victim.jobs.empty()) {
+          out = std::move(victim.jobs.back());
+          victim.jobs.pop_back();
+          return true;
+        }
+      }
+      return false;
+    }
+
+    void run(unsigned index, std::stop_token stop) {
+      Job job;
+      while (!stop.stop_requested()) {
+        if (!try_pop(index, job)) {
+          std::unique_lock lock(sleep_mutex);
+          wake.wait(lock, stop, [this] { return queued.load(std::memory_order_acquire) > 0; });
+          continue;
+        }
+        queued.fetch_sub(1, std::memory_order_relaxed);
+
+        job(index);
+        job = nullptr;
+
+        if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+          pending.notify_all();
+      }
+    }
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<std::size_t> queued{0};  // sitting in a queue
+    std::atomic<std::size_t> pending{0}; // queued or running
+    std::atomic<unsigned> next_queue{0};
+
+    std::mutex sleep_mutex;
+    std::condition_variable_any wake;
+
+    std::vector<std::jthread> threads; // last, so the workers stop before the queues go away
+  };
+}
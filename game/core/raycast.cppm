@@ -47,6 +47,16 @@ export class raycast
 			Chunk* chunk = chunkManager.getChunk(worldResult);
 
 			if (chunk) {
+				if (chunk->occupancy() == ChunkOccupancy::Opaque)
+					return worldResult;
+				if (chunk->occupancy() == ChunkOccupancy::Empty) {
+					// Nothing to hit in here, walk straight to the next chunk
+					const glm::ivec3 chunkPos = chunk->position;
+					while (t <= maxDistance && world_to_chunk(worldResult) == chunkPos)
+						advance(worldResult, tMax, tDelta, step, t);
+					continue;
+				}
+
 				glm::ivec3 localVoxelPos = world_to_local(worldResult);
 				int        blockIndex    = chunk->get_index(localVoxelPos.x, localVoxelPos.y, localVoxelPos.z);
 
@@ -55,27 +65,7 @@ export class raycast
 				}
 			}
 
-			if (tMax.x < tMax.y) {
-				if (tMax.x < tMax.z) {
-					worldResult.x += step.x;
-					t = tMax.x;
-					tMax.x += tDelta.x;
-				} else {
-					worldResult.z += step.z;
-					t = tMax.z;
-					tMax.z += tDelta.z;
-				}
-			} else {
-				if (tMax.y < tMax.z) {
-					worldResult.y += step.y;
-					t = tMax.y;
-					tMax.y += tDelta.y;
-				} else {
-					worldResult.z += step.z;
-					t = tMax.z;
-					tMax.z += tDelta.z;
-				}
-			}
+			advance(worldResult, tMax, tDelta, step, t);
 		}
 
 		return std::nullopt;
@@ -111,6 +101,18 @@ export class raycast
 			Chunk* chunk = chunkManager.getChunk(worldResult);
 
 			if (chunk) {
+				if (chunk->occupancy() == ChunkOccupancy::Opaque)
+					return std::make_pair(worldResult, worldResult - lastVoxel);
+				if (chunk->occupancy() == ChunkOccupancy::Empty) {
+					// Nothing to hit in here, walk straight to the next chunk
+					const glm::ivec3 chunkPos = chunk->position;
+					while (t < maxDistance && world_to_chunk(worldResult) == chunkPos) {
+						lastVoxel = worldResult;
+						advance(worldResult, tMax, tDelta, step, t);
+					}
+					continue;
+				}
+
 				glm::ivec3 localVoxelPos = world_to_local(worldResult);
 				int        blockIndex    = chunk->get_index(localVoxelPos.x, localVoxelPos.y, localVoxelPos.z);
 
@@ -121,29 +123,36 @@ export class raycast
 
 			lastVoxel = worldResult;
 
-			if (tMax.x < tMax.y) {
-				if (tMax.x < tMax.z) {
-					worldResult.x += step.x;
-					t = tMax.x;
-					tMax.x += tDelta.x;
-				} else {
-					worldResult.z += step.z;
-					t = tMax.z;
-					tMax.z += tDelta.z;
-				}
-			} else {
-				if (tMax.y < tMax.z) {
-					worldResult.y += step.y;
-					t = tMax.y;
-					tMax.y += tDelta.y;
-				} else {
-					worldResult.z += step.z;
-					t = tMax.z;
-					tMax.z += tDelta.z;
-				}
-			}
+			advance(worldResult, tMax, tDelta, step, t);
 		}
 
 		return std::nullopt;
 	}
+
+      private:
+	// One DDA step across the nearest voxel boundary
+	static void advance(glm::ivec3& worldResult, glm::vec3& tMax, const glm::vec3& tDelta, const glm::ivec3& step, float& t) noexcept
+	{
+		if (tMax.x < tMax.y) {
+			if (tMax.x < tMax.z) {
+				worldResult.x += step.x;
+				t = tMax.x;
+				tMax.x += tDelta.x;
+			} else {
+				worldResult.z += step.z;
+				t = tMax.z;
+				tMax.z += tDelta.z;
+			}
+		} else {
+			if (tMax.y < tMax.z) {
+				worldResult.y += step.y;
+				t = tMax.y;
+				tMax.y += tDelta.y;
+			} else {
+				worldResult.z += step.z;
+				t = tMax.z;
+				tMax.z += tDelta.z;
+			}
+		}
+	}
 };
@@ -16,6 +16,7 @@ import core;
 import gl_state;
 import timer;
 import chunk_manager;
+import quad_format;
 import input_manager;
 import logger;
 
@@ -147,6 +148,28 @@ export {
       ImGui::Indent();
       ImGui::Text("FPS: %f", getFPS(frame_ctx.delta_time));
       ImGui::Text("Draw Calls: %d", g_drawCallCount);
+      const StreamStats& stream = manager.stream_stats();
+      ImGui::Text("Chunk streaming: %zu to load, %zu to unload", stream.queued_loads, stream.queued_unloads);
+      ImGui::Text("Last frame: %d loaded, %d unloaded, %zu KB, %.2f ms", stream.loaded, stream.unloaded, stream.uploaded_bytes / 1024, stream.ms);
+      const auto cache = manager.mesh_cache_stats();
+      ImGui::Text("Mesh cache: %zu of %zu hit, %zu shared uploads, %zu entries, %zu KB, %zu evicted", cache.hits, cache.lookups, cache.shares, cache.entries, cache.bytes / 1024, cache.evictions);
+      const auto buffer = manager.buffer_stats();
+      ImGui::Text("Quad buffer (generation %d): %u of %u KB, %u slots, %u free blocks, largest %u KB, %.0f%% fragmented", manager.buffer_generation(),
+          buffer.used * QUAD_SIZE / 1024, buffer.capacity * QUAD_SIZE / 1024, buffer.allocations, buffer.freeBlocks,
+          buffer.largestFree * QUAD_SIZE / 1024, buffer.fragmentation() * 100.0f);
+      const auto commands = manager.command_ring_stats();
+      const auto staging = manager.staging_ring_stats();
+      ImGui::Text("Frames in flight: %zu, stalls %llu of %llu command regions, %llu of %llu staging regions", commands.regions,
+          (unsigned long long)commands.stalls, (unsigned long long)commands.retired, (unsigned long long)staging.stalls,
+          (unsigned long long)staging.retired);
+      const auto uploads = manager.upload_queue_stats();
+      ImGui::Text("Upload queue: %zu waiting, %zu KB, latency %.1f ms (mean %.1f, max %.1f), %zu superseded", uploads.depth,
+          uploads.bytes / 1024, uploads.lastLatencyMs, uploads.meanLatencyMs, uploads.maxLatencyMs, uploads.superseded);
+#if defined(REGION_BATCHES)
+      const auto regions = manager.region_batch_stats();
+      ImGui::Text("Region batches: %zu regions, last flush rebuilt %zu faces, %zu KB uploaded, %zu KB copied", regions.regions,
+          regions.rebuilds, regions.uploadedQuads * QUAD_SIZE / 1024, regions.copiedQuads * QUAD_SIZE / 1024);
+#endif
       RenderTimings();
       ImGui::Unindent();
       ImGui::Spacing();
@@ -13,6 +13,8 @@ uniform mat4 u_view;
 uniform mat4 u_projection;
 
 uniform ivec3 eye_position_int;
+// Chunk baseInstance positions are relative to, see pack_base_instance()
+uniform ivec3 u_render_origin;
 
 out VS_OUT {
   out vec3 pos;
@@ -42,16 +44,27 @@ const vec3 colorLookup[8] = {
 
 const int flipLookup[6] = int[6](1, -1, -1, 1, -1, 1);
 
-void main() {
-  ivec3 chunkOffsetPos = ivec3(gl_BaseInstance&255u, gl_BaseInstance>>8&255u, gl_BaseInstance>>16&255u) * 62;
-  uint face = gl_BaseInstance>>24;
+// Drawn without indices, 6 vertices per quad: two triangles over corners 0-3
+const int cornerLookup[6] = int[6](2, 0, 1, 1, 3, 2);
 
-  int vertexID = int(gl_VertexID&3u);
-  uint ssboIndex = gl_VertexID >> 2u;
+void main() {
+  int vertexID = cornerLookup[gl_VertexID % 6];
+  uint ssboIndex = uint(gl_VertexID) / 6u;
 
   uint quadData1 = data[ssboIndex].quadData1;
   uint quadData2 = data[ssboIndex].quadData2;
 
+  // baseInstance has the chunk in signed 8 bits per axis, relative to u_render_origin. Drawn
+  // by region (REGION_BATCHES), that's the region's first chunk and the quad's own is its slot
+  // (bits 8-13, 2 per axis) past it; the slot is 0 for quads drawn by chunk
+  uint regionSlot = quadData2 >> 8u;
+  int baseInstance = int(gl_BaseInstance);
+  ivec3 chunkPos = u_render_origin + ivec3(bitfieldExtract(baseInstance, 0, 8), bitfieldExtract(baseInstance, 8, 8),
+      bitfieldExtract(baseInstance, 16, 8));
+  chunkPos += ivec3(regionSlot&3u, regionSlot>>2u&3u, regionSlot>>4u&3u);
+  ivec3 chunkOffsetPos = chunkPos * 62;
+  uint face = gl_BaseInstance>>24;
+
   ivec3 iVertexPos = ivec3(quadData1, quadData1 >> 6u, quadData1 >> 12u) & 63;
   iVertexPos += chunkOffsetPos;
 
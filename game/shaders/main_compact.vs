@@ -0,0 +1,87 @@
+#version 460 core
+
+// main.vs with 4 byte quads (COMPACT_QUADS, see quad_format.cppm): x, y, z 6 bits each,
+// w - 1 and h - 1 5 bits each, and the block type's index into the draw's palette
+layout(binding = 0, std430) readonly buffer ssbo1 {
+  uint data[];
+};
+
+// Per draw, its chunk's block types by palette index, 4 to a uint
+layout(binding = 1, std430) readonly buffer ssbo2 {
+  uvec4 palettes[];
+};
+
+uniform mat4 u_view;
+uniform mat4 u_projection;
+
+uniform ivec3 eye_position_int;
+// Chunk baseInstance positions are relative to, see pack_base_instance()
+uniform ivec3 u_render_origin;
+
+out VS_OUT {
+  out vec3 pos;
+  flat vec3 normal;
+  flat vec3 color;
+} vs_out;
+
+const vec3 normalLookup[6] = {
+  vec3( 0, 1, 0 ),
+  vec3(0, -1, 0 ),
+  vec3( 1, 0, 0 ),
+  vec3( -1, 0, 0 ),
+  vec3( 0, 0, 1 ),
+  vec3( 0, 0, -1 )
+};
+
+const vec3 colorLookup[8] = {
+  vec3(0.2, 0.659, 0.839),
+  vec3(0.302, 0.302, 0.302),
+  vec3(0.278, 0.600, 0.141),
+  vec3(0.1, 0.1, 0.6),
+  vec3(0.1, 0.6, 0.6),
+  vec3(0.6, 0.1, 0.6),
+  vec3(0.6, 0.6, 0.1),
+  vec3(0.6, 0.1, 0.1)
+};
+
+const int flipLookup[6] = int[6](1, -1, -1, 1, -1, 1);
+
+// Drawn without indices, 6 vertices per quad: two triangles over corners 0-3
+const int cornerLookup[6] = int[6](2, 0, 1, 1, 3, 2);
+
+void main() {
+  // Signed 8 bits per axis, relative to u_render_origin
+  int baseInstance = int(gl_BaseInstance);
+  ivec3 chunkPos = u_render_origin + ivec3(bitfieldExtract(baseInstance, 0, 8), bitfieldExtract(baseInstance, 8, 8),
+      bitfieldExtract(baseInstance, 16, 8));
+  ivec3 chunkOffsetPos = chunkPos * 62;
+  uint face = gl_BaseInstance>>24;
+
+  int vertexID = cornerLookup[gl_VertexID % 6];
+  uint ssboIndex = uint(gl_VertexID) / 6u;
+
+  uint quadData = data[ssboIndex];
+
+  ivec3 iVertexPos = ivec3(quadData, quadData >> 6u, quadData >> 12u) & 63;
+  iVertexPos += chunkOffsetPos;
+
+  int w = int((quadData >> 18u)&31u) + 1, h = int((quadData >> 23u)&31u) + 1;
+  uint paletteIndex = quadData >> 28u;
+  uint type = (palettes[gl_DrawID][paletteIndex >> 2u] >> ((paletteIndex & 3u) * 8u)) & 255u;
+  uint wDir = (face & 2) >> 1, hDir = 2 - (face >> 2);
+  int wMod = vertexID >> 1, hMod = vertexID & 1;
+
+  iVertexPos[wDir] += (w * wMod * flipLookup[face]);
+  iVertexPos[hDir] += (h * hMod);
+
+  vs_out.pos = iVertexPos;
+  vs_out.normal = normalLookup[face];
+  vs_out.color = colorLookup[type - 1];
+
+  // vec3 vertexPos = iVertexPos - eye_position_int;
+  vec3 vertexPos = iVertexPos;
+  vertexPos[wDir] += 0.0007 * flipLookup[face] * (wMod * 2 - 1);
+  vertexPos[hDir] += 0.0007 * (hMod * 2 - 1);
+
+  gl_Position = u_projection * u_view * vec4(vertexPos, 1);
+}
@@ -25,6 +25,31 @@ elseif is_mode("release") then
     set_optimize("fastest")
 end
 
+-- 4 byte quads with a per-chunk block type palette instead of the mesher's 8 byte ones,
+-- see game/chunk/quad_format.cppm
+-- xmake f --compact_quads=y
+option("compact_quads")
+  set_default(false)
+  set_showmenu(true)
+  set_description("Pack chunk quads into 4 bytes")
+option_end()
+
+if has_config("compact_quads") then
+  add_defines("COMPACT_QUADS")
+end
+
+-- see game/chunk/region_batches.cppm, not with compact_quads
+-- xmake f --region_batches=y
+option("region_batches")
+  set_default(false)
+  set_showmenu(true)
+  set_description("Draw chunks in batches of 4x4x4")
+option_end()
+
+if has_config("region_batches") then
+  add_defines("REGION_BATCHES")
+end
+
 
 -- add_cxxflags("-freflection", "-fexpansion-statements", "-freflection-latest")
 -- target("game")
@@ -33,3 +58,113 @@ end
 --   add_deps("engine")
 --   add_files("game/**.cpp")
 --   add_files("game/**.cppm")
+
+-- Headless benchmarks, no window or GL context needed
+-- xmake build bench_chunk_map && xmake run bench_chunk_map
+target("bench_chunk_map")
+  set_kind("binary")
+  set_default(false)
+  set_languages("c++26")
+  add_packages("engine")
+  add_files("game/chunk/chunk_map.cppm")
+  add_files("game/bench/chunk_map_bench.cpp")
+
+target("bench_block_storage")
+  set_kind("binary")
+  set_default(false)
+  set_languages("c++26")
+  add_files("game/chunk/block_storage.cppm")
+  add_files("game/bench/block_storage_bench.cpp")
+
+target("bench_job_system")
+  set_kind("binary")
+  set_default(false)
+  set_languages("c++26")
+  add_files("game/chunk/mesher.cppm")
+  add_files("game/core/job_system.cppm")
+  add_files("game/bench/job_system_bench.cpp")
+
+target("bench_density")
+  set_kind("binary")
+  set_default(false)
+  set_languages("c++26")
+  add_packages("engine")
+  add_files("game/chunk/mesher.cppm")
+  add_files("game/vendor/binary-greedy-meshing/misc/utility.cppm")
+  add_files("game/vendor/binary-greedy-meshing/misc/noise.cppm")
+  add_files("game/chunk/density_field.cppm")
+  add_files("game/bench/density_bench.cpp")
+
+-- Also checks the SIMD kernels against the scalar code, exits with 1 on a mismatch
+target("bench_mesher_simd")
+  set_kind("binary")
+  set_default(false)
+  set_languages("c++26")
+  add_files("game/chunk/mesher.cppm")
+  add_files("game/bench/mesher_simd_bench.cpp")
+
+-- mesh() at chunk sizes 16, 30 and 62 on canonical inputs, JSON on stdout
+-- xmake run bench_mesher [runs]
+target("bench_mesher")
+  set_kind("binary")
+  set_default(false)
+  set_languages("c++26")
+  add_files("game/chunk/mesher.cppm")
+  add_files("game/bench/mesher_bench.cpp")
+
+-- Also checks the allocator's lists while replaying, exits with 1 on an inconsistency
+-- xmake run bench_buffer_allocator [trace]
+target("bench_buffer_allocator")
+  set_kind("binary")
+  set_default(false)
+  set_languages("c++26")
+  add_files("game/chunk/buffer_allocator.cppm")
+  add_files("game/bench/buffer_allocator_bench.cpp")
+
+-- Also checks the AVX2 and scalar masks against the per-box test, exits with 1 on a mismatch
+target("bench_frustum_cull")
+  set_kind("binary")
+  set_default(false)
+  set_languages("c++26")
+  add_files("game/chunk/frustum_cull.cppm")
+  add_files("game/bench/frustum_cull_bench.cpp")
+
+-- Also checks the ring never hands out a region the mock GPU isn't done with, exits with 1 if it does
+target("bench_frame_ring")
+  set_kind("binary")
+  set_default(false)
+  set_languages("c++26")
+  add_files("game/chunk/frame_ring.cppm")
+  add_files("game/bench/frame_ring_bench.cpp")
+
+target("bench_lod")
+  set_kind("binary")
+  set_default(false)
+  set_languages("c++26")
+  add_files("game/chunk/mesher.cppm")
+  add_files("game/chunk/lod.cppm")
+  add_files("game/bench/lod_bench.cpp")
+
+-- Also checks the 4 byte quads cover the same cells as the 8 byte ones, exits with 1 on a mismatch
+target("bench_quad_format")
+  set_kind("binary")
+  set_default(false)
+  set_languages("c++26")
+  add_files("game/chunk/mesher.cppm")
+  add_files("game/chunk/quad_format.cppm")
+  add_files("game/bench/quad_format_bench.cpp")
+
+-- Also checks every region's quads against its chunks' after each flush, exits with 1 on a mismatch
+target("bench_region_batches")
+  set_kind("binary")
+  set_default(false)
+  set_languages("c++26")
+  add_packages("engine")
+  add_files("game/chunk/chunk_map.cppm")
+  add_files("game/chunk/buffer_allocator.cppm")
+  add_files("game/chunk/frustum_cull.cppm")
+  add_files("game/chunk/quad_format.cppm")
+  add_files("game/chunk/draw_command.cppm")
+  add_files("game/chunk/draw_table.cppm")
+  add_files("game/chunk/region_batches.cppm")
+  add_files("game/bench/region_batches_bench.cpp")